@@ -0,0 +1,207 @@
+######################################################################
+#                                                                    #
+#                                                                    #
+#                    Memory Footprint Report Config                  #
+#                          For CMake                                 #
+#                                                                    #
+#                      By Tyler J. Anderson                          #
+#                                                                    #
+#                                                                    #
+######################################################################
+
+# Include this library in the top-level CMakeLists.txt and call the
+# macro swapkfootprint(target) for each executable to add a
+# <target>-footprint target. It writes <target>-footprint.txt next to
+# the executable with:
+#
+# - Flash and RAM totals from size
+# - The swapk configuration the target was built with
+# - The largest RAM and flash symbols from nm
+#
+# A swapk-footprint target builds every report and writes
+# swapk-footprint.txt in the top-level build directory, one line per
+# configuration, so builds of the same program with different SWAPK_
+# settings can be compared side by side.
+#
+# This file is also the script those targets run, in CMake script mode
+#
+# Dependencies:
+# - size and nm for the target toolchain
+
+if(CMAKE_SCRIPT_MODE_FILE AND FOOTPRINT_SUMMARY)
+
+  #####################
+  # SUMMARY GENERATOR #
+  #####################
+
+  string(REPLACE "|" ";" footprint_reports "${FOOTPRINT_REPORTS}")
+  set(footprint_rows "")
+
+  foreach(report IN LISTS footprint_reports)
+    file(READ ${report} footprint_report)
+
+    string(REGEX MATCH "Footprint of ([^\n]+)" _ "${footprint_report}")
+    get_filename_component(name "${CMAKE_MATCH_1}" NAME_WE)
+    string(REGEX MATCH "Flash: ([0-9]+)" _ "${footprint_report}")
+    set(flash "${CMAKE_MATCH_1}")
+    string(REGEX MATCH "RAM \\(static\\): ([0-9]+)" _
+      "${footprint_report}")
+    set(ram "${CMAKE_MATCH_1}")
+    string(REGEX MATCH "Configuration:\n((  [^\n]*\n)*)" _
+      "${footprint_report}")
+    string(STRIP "${CMAKE_MATCH_1}" config)
+    string(REGEX REPLACE "\n +" " " config "${config}")
+
+    if(config STREQUAL "")
+      set(config "(defaults)")
+    endif()
+
+    string(APPEND footprint_rows "${name}\t${flash}\t${ram}\t${config}\n")
+  endforeach()
+
+  file(WRITE ${FOOTPRINT_OUT}
+    "Footprint by configuration\n\n"
+    "Target\tFlash\tRAM\tConfiguration\n"
+    "${footprint_rows}")
+
+  file(READ ${FOOTPRINT_OUT} footprint_report)
+  message("${footprint_report}")
+
+  return()
+
+elseif(CMAKE_SCRIPT_MODE_FILE)
+
+  ####################
+  # REPORT GENERATOR #
+  ####################
+
+  execute_process(COMMAND ${FOOTPRINT_SIZE} -B ${FOOTPRINT_ELF}
+    OUTPUT_VARIABLE footprint_berkeley)
+
+  execute_process(COMMAND ${FOOTPRINT_SIZE} -A ${FOOTPRINT_ELF}
+    OUTPUT_VARIABLE footprint_sections)
+
+  execute_process(COMMAND ${FOOTPRINT_NM} -S -C --size-sort -r
+    ${FOOTPRINT_ELF}
+    OUTPUT_VARIABLE footprint_symbols)
+
+  # text includes .data's load image, bss and data are what sits in
+  # RAM before any stack or heap
+  string(REGEX MATCH "\n *([0-9]+)[ \t]+([0-9]+)[ \t]+([0-9]+)"
+    footprint_totals "${footprint_berkeley}")
+  set(footprint_flash "${CMAKE_MATCH_1}")
+  math(EXPR footprint_ram "${CMAKE_MATCH_2} + ${CMAKE_MATCH_3}")
+
+  string(REPLACE "|" "\n  " footprint_config "${FOOTPRINT_CONFIG}")
+
+  # Keep symbols in RAM (bBdD) and flash (tTrR) separately
+  string(REPLACE "\n" ";" footprint_lines "${footprint_symbols}")
+  set(footprint_ram_syms "")
+  set(footprint_flash_syms "")
+  set(footprint_ram_cnt 0)
+  set(footprint_flash_cnt 0)
+
+  foreach(line IN LISTS footprint_lines)
+    if(line MATCHES "^[0-9a-fA-F]+ ([0-9a-fA-F]+) ([bBdD]) (.*)$"
+	AND footprint_ram_cnt LESS ${FOOTPRINT_TOP})
+      math(EXPR bytes "0x${CMAKE_MATCH_1}")
+      string(APPEND footprint_ram_syms "  ${bytes}\t${CMAKE_MATCH_3}\n")
+      math(EXPR footprint_ram_cnt "${footprint_ram_cnt} + 1")
+    elseif(line MATCHES "^[0-9a-fA-F]+ ([0-9a-fA-F]+) ([tTrR]) (.*)$"
+	AND footprint_flash_cnt LESS ${FOOTPRINT_TOP})
+      math(EXPR bytes "0x${CMAKE_MATCH_1}")
+      string(APPEND footprint_flash_syms "  ${bytes}\t${CMAKE_MATCH_3}\n")
+      math(EXPR footprint_flash_cnt "${footprint_flash_cnt} + 1")
+    endif()
+  endforeach()
+
+  file(WRITE ${FOOTPRINT_OUT}
+    "Footprint of ${FOOTPRINT_ELF}\n\n"
+    "Flash: ${footprint_flash} bytes\n"
+    "RAM (static): ${footprint_ram} bytes\n\n"
+    "Configuration:\n  ${footprint_config}\n\n"
+    "Largest RAM symbols:\n${footprint_ram_syms}\n"
+    "Largest flash symbols:\n${footprint_flash_syms}\n"
+    "Sections:\n${footprint_sections}")
+
+  file(READ ${FOOTPRINT_OUT} footprint_report)
+  message("${footprint_report}")
+
+  return()
+
+endif()
+
+set(SWAPK_FOOTPRINT_SCRIPT ${CMAKE_CURRENT_LIST_FILE})
+
+# Runs once the whole tree is configured, so every report is known
+function(_swapkfootprint_summary)
+
+  get_property(reports GLOBAL PROPERTY SWAPK_FOOTPRINT_REPORTS)
+  get_property(targets GLOBAL PROPERTY SWAPK_FOOTPRINT_TARGETS)
+
+  if(NOT targets)
+    return()
+  endif()
+
+  string(JOIN "|" reports ${reports})
+
+  add_custom_target(swapk-footprint
+    COMMAND ${CMAKE_COMMAND}
+    -DFOOTPRINT_SUMMARY=1
+    -DFOOTPRINT_REPORTS=${reports}
+    -DFOOTPRINT_OUT=${CMAKE_BINARY_DIR}/swapk-footprint.txt
+    -P ${SWAPK_FOOTPRINT_SCRIPT}
+    COMMENT "Footprint report for every configuration"
+    VERBATIM)
+
+  add_dependencies(swapk-footprint ${targets})
+
+endfunction()
+
+cmake_language(DEFER DIRECTORY ${CMAKE_SOURCE_DIR}
+  CALL _swapkfootprint_summary)
+
+macro(swapkfootprint target)
+
+  ############################
+  # FOOTPRINT REPORT OPTIONS #
+  ############################
+
+  set(SWAPK_FOOTPRINT_TOP 16 CACHE STRING
+    "Symbols to list per memory in footprint reports")
+
+  get_filename_component(swapk_toolchain_dir ${CMAKE_NM} DIRECTORY)
+  # arm-none-eabi-nm -> arm-none-eabi-size
+  get_filename_component(swapk_size_name ${CMAKE_NM} NAME_WE)
+  string(REGEX REPLACE "nm$" "size" swapk_size_name ${swapk_size_name})
+
+  find_program(SWAPK_FOOTPRINT_SIZE ${swapk_size_name} size
+    HINTS ${swapk_toolchain_dir})
+
+  if(SWAPK_FOOTPRINT_SIZE AND CMAKE_NM)
+
+    add_custom_target(${target}-footprint
+      COMMAND ${CMAKE_COMMAND}
+      -DFOOTPRINT_ELF=$<TARGET_FILE:${target}>
+      -DFOOTPRINT_OUT=$<TARGET_FILE:${target}>-footprint.txt
+      -DFOOTPRINT_SIZE=${SWAPK_FOOTPRINT_SIZE}
+      -DFOOTPRINT_NM=${CMAKE_NM}
+      -DFOOTPRINT_TOP=${SWAPK_FOOTPRINT_TOP}
+      "-DFOOTPRINT_CONFIG=$<JOIN:$<FILTER:$<TARGET_PROPERTY:${target},COMPILE_DEFINITIONS>,INCLUDE,^SWAPK_>,|>"
+      -P ${SWAPK_FOOTPRINT_SCRIPT}
+      DEPENDS ${target}
+      COMMENT "Footprint report for ${target}"
+      VERBATIM)
+
+    set_property(GLOBAL APPEND PROPERTY SWAPK_FOOTPRINT_TARGETS
+      ${target}-footprint)
+    set_property(GLOBAL APPEND PROPERTY SWAPK_FOOTPRINT_REPORTS
+      $<TARGET_FILE:${target}>-footprint.txt)
+
+  else()
+
+    message(NOTICE "Footprint report for ${target} will not be built")
+
+  endif()
+
+endmacro()
@@ -1,4 +1,5 @@
 #include "swapk-pico-integration.h"
+#include "swapk-pico-stdio.h"
 
 #include "pico/stdlib.h"
 #include "pico/sync.h"
@@ -9,10 +10,12 @@
 #include <string.h>
 
 #define SWAPK_STACK_SIZE_SETUP 1024
+#define SWAPK_STACK_SIZE_STDIO 1024
 #define SWAPK_STACK_SIZE_A (4 * 2048)
 #define SWAPK_STACK_SIZE_B (4 * 2048)
 
 SWAPK_DEFINE_STACK(stacksetup, SWAPK_STACK_SIZE_SETUP);
+SWAPK_DEFINE_STACK(stackstdio, SWAPK_STACK_SIZE_STDIO);
 SWAPK_DEFINE_STACK(stacka, SWAPK_STACK_SIZE_A);
 SWAPK_DEFINE_STACK(stackb, SWAPK_STACK_SIZE_B);
 
@@ -33,6 +36,10 @@ void *setup_entry(void *arg)
 		tight_loop_contents();
 	}
 
+	/* From here printf() never waits on USB. The writer ranks
+	 * below the printers but above the idle processes (20) */
+	swapk_pico_stdio_init(&stackstdio, 10);
+
 	sem_release(&app_setup_sem);
 	printf("You are connected!\n");
 
@@ -0,0 +1,107 @@
+#include "swapk-pico-integration.h"
+#include "swapk_jobs.h"
+
+#include "pico/stdlib.h"
+
+#include <stdio.h>
+
+#define SWAPK_STACK_SIZE_BENCH (4 * 1024)
+#define SWAPK_STACK_SIZE_WORKER 1024
+
+#define BENCH_SAMPLES 4096
+#define BENCH_TAPS 32
+#define BENCH_GRAIN 256
+#define BENCH_RUNS 8
+
+SWAPK_DEFINE_STACK(stackbench, SWAPK_STACK_SIZE_BENCH);
+SWAPK_DEFINE_STACK(stackone0, SWAPK_STACK_SIZE_WORKER);
+SWAPK_DEFINE_STACK(stacktwo0, SWAPK_STACK_SIZE_WORKER);
+SWAPK_DEFINE_STACK(stacktwo1, SWAPK_STACK_SIZE_WORKER);
+
+static swapk_proc_t procbench;
+
+/* Same work run on a pool with one worker and on one with a worker
+ * on each core */
+static swapk_jobs_t jobsone;
+static swapk_jobs_t jobstwo;
+
+static int16_t samples[BENCH_SAMPLES + BENCH_TAPS];
+static int16_t taps[BENCH_TAPS];
+static int32_t output[BENCH_SAMPLES];
+
+static void *bench_entry(void*);
+static void fir_job(void *arg, int begin, int end);
+static uint32_t bench_run(swapk_jobs_t *jobs);
+
+void fir_job(void *arg, int begin, int end)
+{
+	(void) arg;
+
+	for (int i = begin; i < end; ++i) {
+		int32_t acc = 0;
+
+		for (int t = 0; t < BENCH_TAPS; ++t)
+			acc += samples[i + t] * taps[t];
+
+		output[i] = acc;
+	}
+}
+
+uint32_t bench_run(swapk_jobs_t *jobs)
+{
+	uint32_t start = time_us_32();
+
+	for (int i = 0; i < BENCH_RUNS; ++i)
+		swapk_parallel_for(jobs, 0, BENCH_SAMPLES, BENCH_GRAIN,
+				   fir_job, NULL);
+
+	return time_us_32() - start;
+}
+
+void *bench_entry(void *arg)
+{
+	unsigned long one;
+	unsigned long two;
+
+	stdio_usb_init();
+
+	while(!stdio_usb_connected()) {
+		sleep_ms(100);
+	}
+
+	for (int i = 0; i < BENCH_SAMPLES + BENCH_TAPS; ++i)
+		samples[i] = (int16_t) ((i * 7919) & 0x7fff) - 0x4000;
+
+	for (int t = 0; t < BENCH_TAPS; ++t)
+		taps[t] = (int16_t) (t < BENCH_TAPS / 2 ? t : BENCH_TAPS - t);
+
+	for (;;) {
+		one = bench_run(&jobsone);
+		two = bench_run(&jobstwo);
+
+		printf("FIR %d x %d taps, %d runs: 1 core %lu us, "
+		       "2 cores %lu us, speedup %lu.%02lux\n",
+		       BENCH_SAMPLES, BENCH_TAPS, BENCH_RUNS, one, two,
+		       one / two, (one * 100 / two) % 100);
+
+		sleep_ms(5000);
+	}
+
+	return arg;
+}
+
+int main()
+{
+	swapk_pico_init();
+
+	swapk_jobs_init(&jobsone, swapk_pico_scheduler());
+	swapk_jobs_add_worker(&jobsone, &stackone0, 1, 0);
+
+	swapk_jobs_init(&jobstwo, swapk_pico_scheduler());
+	swapk_jobs_add_worker(&jobstwo, &stacktwo0, 1, 0);
+	swapk_jobs_add_worker(&jobstwo, &stacktwo1, 1, 1);
+
+	/* Bench only submits and sleeps, so leave it free to float */
+	swapk_pico_proc_init(&procbench, &stackbench, bench_entry, 2);
+	swapk_pico_start();
+}
@@ -0,0 +1,128 @@
+######################################################################
+#                                                                    #
+#                                                                    #
+#                  RP2040 Memory Placement Check Config              #
+#                          For CMake                                 #
+#                                                                    #
+#                      By Tyler J. Anderson                          #
+#                                                                    #
+#                                                                    #
+######################################################################
+
+# Include this library and call the macro swapkpicoplacement(target)
+# for each executable to add a <target>-placement target. It reads
+# the linked symbol addresses and fails if:
+#
+# - SWAPK_RAM_HOT_PATHS is on and a scheduler hot path is in flash
+# - SWAPK_PICO_SCRATCH_STACKS is on and an idle stack or
+#   scheduler_ptr is outside its SCRATCH bank
+#
+# This file is also the script that target runs, in CMake script mode
+#
+# Dependencies:
+# - nm for the target toolchain
+
+if(CMAKE_SCRIPT_MODE_FILE)
+
+  ###################
+  # PLACEMENT CHECK #
+  ###################
+
+  # RP2040 memory map
+  set(ram_start 0x20000000)
+  set(scratch_x_start 0x20040000)
+  set(scratch_y_start 0x20041000)
+  set(scratch_end 0x20042000)
+
+  set(checks "")
+
+  if(PLACEMENT_HOT)
+    # Static helpers may be inlined, so only check functions that
+    # are public or called through a pointer
+    foreach(sym
+	_swapk_system_entry swapk_yield swapk_notify swapk_core_kicked
+	isr_irq11 isr_irq14 swapk_pendsv_swap swapk_set_pending
+	_swapk_pico_cb_mutex_lock_queue _swapk_pico_fifo_irq_handler)
+      list(APPEND checks "${sym}|${ram_start}|${scratch_end}")
+    endforeach()
+  endif()
+
+  if(PLACEMENT_SCRATCH)
+    list(APPEND checks
+      "_swapk_pico_sleep_stack0|${scratch_y_start}|${scratch_end}"
+      "_swapk_pico_sleep_stack1|${scratch_x_start}|${scratch_y_start}"
+      "scheduler_ptr|${scratch_x_start}|${scratch_end}")
+  endif()
+
+  if(NOT checks)
+    message("${PLACEMENT_ELF}: no placement options enabled")
+    return()
+  endif()
+
+  execute_process(COMMAND ${PLACEMENT_NM} ${PLACEMENT_ELF}
+    OUTPUT_VARIABLE placement_symbols
+    RESULT_VARIABLE placement_result)
+
+  if(NOT placement_result EQUAL 0)
+    message(FATAL_ERROR "Could not read symbols from ${PLACEMENT_ELF}")
+  endif()
+
+  set(placement_errors "")
+
+  foreach(check IN LISTS checks)
+    string(REPLACE "|" ";" check "${check}")
+    list(GET check 0 sym)
+    list(GET check 1 lo)
+    list(GET check 2 hi)
+
+    if(NOT placement_symbols MATCHES "(^|\n)([0-9a-fA-F]+) [a-zA-Z] ${sym}\n")
+      string(APPEND placement_errors "  ${sym}: not found\n")
+      continue()
+    endif()
+
+    math(EXPR addr "0x${CMAKE_MATCH_2}")
+    math(EXPR lo "${lo}")
+    math(EXPR hi "${hi}")
+
+    if(addr LESS lo OR NOT addr LESS hi)
+      math(EXPR addr_hex "${addr}" OUTPUT_FORMAT HEXADECIMAL)
+      string(APPEND placement_errors
+	"  ${sym}: at ${addr_hex}, outside the expected region\n")
+    else()
+      message("  ok ${sym}")
+    endif()
+  endforeach()
+
+  if(placement_errors)
+    message(FATAL_ERROR
+      "Misplaced symbols in ${PLACEMENT_ELF}:\n${placement_errors}")
+  endif()
+
+  return()
+
+endif()
+
+set(SWAPK_PICO_PLACEMENT_SCRIPT ${CMAKE_CURRENT_LIST_FILE})
+
+macro(swapkpicoplacement target)
+
+  if(CMAKE_NM)
+
+    add_custom_target(${target}-placement
+      COMMAND ${CMAKE_COMMAND}
+      -DPLACEMENT_ELF=$<TARGET_FILE:${target}>
+      -DPLACEMENT_NM=${CMAKE_NM}
+      -DPLACEMENT_HOT=${SWAPK_RAM_HOT_PATHS}
+      -DPLACEMENT_SCRATCH=${SWAPK_PICO_SCRATCH_STACKS}
+      -P ${SWAPK_PICO_PLACEMENT_SCRIPT}
+      DEPENDS ${target}
+      COMMENT "Checking memory placement of ${target}"
+      VERBATIM)
+
+  else()
+
+    message(NOTICE "Placement check for ${target} will not be built")
+
+  endif()
+
+endmacro()
@@ -12,17 +12,36 @@
 
 #include "swapk.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * @defgroup swapk_pico Pico functions for Swapkernel
  * @{
  */
 
-#define SWAPK_PICO_LOCK_MAP_LENGTH 256
 #define SWAPK_PICO_MAX_TIMERS 16
 #define SWAPK_PICO_HARDWARE_ALARM_NO 0
 
+#ifndef SWAPK_PICO_SCRATCH_STACKS
+/** @brief Set greater than 0 to put each core's idle stack in its
+ * SCRATCH bank. Also needs SWAPK_EXTERNAL_SLEEP_STACKS */
+#define SWAPK_PICO_SCRATCH_STACKS 0
+#endif
+
 swapk_scheduler_t *swapk_pico_scheduler();
 
+/**
+ * @brief Set up the scheduler and its callbacks on the Pico SDK
+ *
+ * Cores kick each other over the inter-core FIFO, so once each core
+ * is started the integration owns its SIO FIFO interrupt and drains
+ * every word that arrives. Nothing else may use the FIFO after
+ * launch. That includes multicore_lockout_victim_init() and
+ * anything built on the lockout, which would also panic trying to
+ * claim the same interrupt.
+ */
 void swapk_pico_init();
 
 void swapk_pico_start();
@@ -30,17 +49,30 @@ void swapk_pico_start();
 void swapk_pico_proc_init(swapk_proc_t *proc, swapk_stack_t *stack,
 			  swapk_entry entry, int priority);
 
-void swapk_pico_wait(absolute_time_t time,
+/**
+ * @brief Release a held lock_core spinlock and wait for a notify
+ *
+ * @return true if @p time has passed, as best_effort_wfe_or_timeout()
+ */
+bool swapk_pico_wait(absolute_time_t time,
 		     lock_core_t *lock_core, uint32_t save);
 
 void swapk_pico_yield_until(absolute_time_t time);
 
+/** @brief Release a held lock_core spinlock and wake its waiters */
 void swapk_pico_notify(lock_core_t *lock_core, uint32_t save);
 
 lock_owner_id_t swapk_pico_get_current_pid();
 
+/** @brief Swapk time for @p us microseconds since boot */
+SWAPK_ABSOLUTE_TIME_T swapk_pico_time_from_us(uint64_t us);
+
 /**
  * @}
  */
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* #ifndef SWAPK_PICO_INTEGRATION_H */
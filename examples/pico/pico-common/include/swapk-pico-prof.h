@@ -0,0 +1,56 @@
+/**
+ * @file swapk-pico-prof.h
+ * @author Tyler J. Anderson
+ * @brief SysTick driven sampling profiler on the Pico SDK
+ */
+
+#ifndef SWAPK_PICO_PROF_H
+#define SWAPK_PICO_PROF_H
+
+#include "swapk.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @addtogroup swapk_pico
+ * @{
+ */
+
+/**
+ * @brief Point the profiler at the Pico scheduler and install
+ * swapk_prof_isr() as the SysTick handler
+ *
+ * Call once, after swapk_pico_init().
+ */
+void swapk_pico_prof_init();
+
+/**
+ * @brief Sample the calling core @p hz times a second
+ *
+ * Each core has its own SysTick, so call from every core to be
+ * profiled.
+ */
+void swapk_pico_prof_start(uint32_t hz);
+
+/** @brief Stop sampling the calling core */
+void swapk_pico_prof_stop();
+
+/**
+ * @brief Print every buffered sample as hex words
+ *
+ * The output is read by tools/swapk-prof.py --hex. Drains the rings,
+ * so samples are only ever printed once.
+ */
+void swapk_pico_prof_dump();
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef SWAPK_PICO_PROF_H */
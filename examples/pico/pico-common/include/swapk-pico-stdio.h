@@ -0,0 +1,62 @@
+/**
+ * @file swapk-pico-stdio.h
+ * @author Tyler J. Anderson
+ * @brief Buffered stdout for swapkernel projects on the Pico SDK
+ */
+
+#ifndef SWAPK_PICO_STDIO_H
+#define SWAPK_PICO_STDIO_H
+
+#include "swapk.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @addtogroup swapk_pico
+ * @{
+ */
+
+#ifndef SWAPK_PICO_STDIO_BUFFER
+/** @brief Bytes of stdout each core can buffer, a power of two */
+#define SWAPK_PICO_STDIO_BUFFER 1024
+#endif
+
+#ifndef SWAPK_PICO_STDIO_FLUSH_US
+/** @brief Longest the writer lets output sit before sending it
+ *
+ * Only counts once something has been printed. With nothing to send
+ * the writer blocks until a print finds its buffer empty.
+ */
+#define SWAPK_PICO_STDIO_FLUSH_US 10000
+#endif
+
+/**
+ * @brief Take stdout off USB CDC and give it to a writer process
+ *
+ * printf() then only copies into a buffer for the calling core and
+ * never waits on stdio_usb_mutex. The writer drains both cores'
+ * buffers to USB CDC in batches. Output that finds the buffer full
+ * is dropped rather than waited for. Call after swapk_pico_init()
+ * and stdio_usb_init(), and don't print from interrupts.
+ *
+ * @param stack Stack for the writer process
+ * @param priority Writer priority, normally below the processes
+ * that print and above SWAPK_SLEEP_PROC_PRIORITY, so it never has
+ * to share the core with an idle process
+ */
+void swapk_pico_stdio_init(swapk_stack_t *stack, int priority);
+
+/** @brief Bytes dropped so far because a buffer was full */
+uint32_t swapk_pico_stdio_dropped();
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef SWAPK_PICO_STDIO_H */
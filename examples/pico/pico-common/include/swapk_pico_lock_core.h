@@ -23,20 +23,19 @@
 
 #define lock_is_owner_id_valid(id) ((id) != LOCK_INVALID_OWNER_ID)
 
+/* The swapk_pico_* calls release the spinlock themselves, after
+ * they have read or bumped the lock's futex word */
 #define lock_internal_spin_unlock_with_wait(lock, save)			\
 	do {								\
-		spin_unlock((lock)->spin_lock, save);			\
 		swapk_pico_wait(at_the_end_of_time, lock, save);	\
 	} while (0);
 
 #define lock_internal_spin_unlock_with_notify(lock, save)	\
 	do {							\
-		spin_unlock((lock)->spin_lock, save);		\
 		swapk_pico_notify(lock, save);			\
 	} while (0);
 
 #define lock_internal_spin_unlock_with_best_effort_wait_or_timeout(lock, save, until) ({ \
-		spin_unlock((lock)->spin_lock, save);			\
 		swapk_pico_wait(until, lock, save);			\
 		})
 
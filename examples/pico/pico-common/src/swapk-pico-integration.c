@@ -6,6 +6,8 @@
 
 #include "swapk-pico-integration.h"
 #include "pico/multicore.h"
+#include "hardware/irq.h"
+#include "hardware/structs/sio.h"
 
 #include "string.h"
 
@@ -13,41 +15,66 @@
 #define ARRAY_LEN(array) (sizeof(array)/sizeof(array[0]))
 #endif
 
-extern mutex_t stdio_usb_mutex;
-
-typedef struct swapk_pico_lock_map_node {
-	lock_core_t lock_core;
-	swapk_pid_t pid;
-	bool used;
-	TAILQ_ENTRY(swapk_pico_lock_map_node) _tailq;
-} swapk_pico_lock_map_t;
-	
-static swapk_pico_lock_map_t _swapk_pico_lock_map_data[SWAPK_PICO_LOCK_MAP_LENGTH];
-static TAILQ_HEAD(_swapk_pico_lock_queue, swapk_pico_lock_map_node)
-	_swapk_pico_lock_maps, _swapk_pico_lock_maps_free;
+/* Bumped by every notify on a spinlock while it is held. Waiters
+ * sleep on these as futex words, so each lock_core sharing a
+ * spinlock shares a word */
+static volatile uint32_t _swapk_pico_lock_seq[NUM_SPIN_LOCKS];
+
+/* One per alarm in the pool. A record belongs to whichever of the
+ * handler or a successful cancel gets to it first */
+typedef struct {
+	swapk_proc_t *proc;
+	uint32_t gen;
+	alarm_id_t id;
+} swapk_pico_alarm_t;
+
+static swapk_pico_alarm_t _swapk_pico_alarms[SWAPK_PICO_MAX_TIMERS];
+static spin_lock_t *_swapk_pico_alarm_lock;
 static swapk_scheduler_t _swapk_pico_scheduler;
 static swapk_callbacks_t _swapk_pico_cbs;
-static unsigned int _swapk_pico_lock_map_cntr;
 static alarm_pool_t *_swapk_pico_alarm_pool;
 static swapk_entry _swapk_pico_core1_entry;
 static void *_swapk_pico_core1_arg;
-static mutex_t _swapk_pico_mtx;
+static spin_lock_t *_swapk_pico_queue_lock;
+static uint32_t _swapk_pico_queue_lock_save[NUM_CORES];
 static semaphore_t _swapk_pico_sch_sem;
 
+/* Set before the FIFO word goes out. The flag is the kick, the word
+ * only raises the interrupt, so a kick that finds the FIFO full
+ * still lands */
+static volatile bool _swapk_pico_kick_pending[NUM_CORES];
+
+#if SWAPK_PICO_SCRATCH_STACKS > 0
+/* Each core's main stack is already in its own scratch bank (core 0
+ * in Y, core 1 in X), so keep the idle stacks next to them */
+static uint8_t __scratch_y("swapk_sleep_stack")
+	_swapk_pico_sleep_stack0[SWAPK_SLEEP_STACK_SIZE] __aligned(8);
+static uint8_t __scratch_x("swapk_sleep_stack")
+	_swapk_pico_sleep_stack1[SWAPK_SLEEP_STACK_SIZE] __aligned(8);
+
+uint8_t *const swapk_sleep_stack_data[SWAPK_HARDWARE_THREADS] = {
+	_swapk_pico_sleep_stack0,
+	_swapk_pico_sleep_stack1
+};
+#endif /* #if SWAPK_PICO_SCRATCH_STACKS > 0 */
+
 static struct timespec _swapk_pico_get_timespec(absolute_time_t time);
 static absolute_time_t _swapk_pico_get_absolute_time(struct timespec time);
 
 static void _swapk_pico_poll_event(void *arg);
 static void _swapk_pico_set_alarm(SWAPK_ABSOLUTE_TIME_T time,
 				  swapk_proc_t *proc);
-static swapk_pico_lock_map_t *_swapk_pico_find_free_lock_map();
-static swapk_pico_lock_map_t
-	*_swapk_pico_free_lock_map(swapk_pico_lock_map_t *lock_map);
+static void _swapk_pico_cancel_alarm(swapk_proc_t *proc);
+static uint32_t _swapk_pico_cb_get_ticks();
+static volatile uint32_t *_swapk_pico_lock_word(lock_core_t *lock_core);
 static void _swapk_pico_cb_signal_event(void* arg);
 static void _swapk_pico_entry_wrapper();
 static void _swapk_pico_cb_core_launch(SWAPK_CORE_ID_T cid,
 				       swapk_entry entry, void* arg);
 static SWAPK_CORE_ID_T _swapk_pico_cb_core_get_id();
+static void _swapk_pico_cb_core_kick(SWAPK_CORE_ID_T cid);
+static void _swapk_pico_fifo_irq_handler();
+static void _swapk_pico_enable_kick_irq();
 static void _swapk_pico_cb_mutex_lock_queue();
 static void _swapk_pico_cb_mutex_unlock_queue();
 static void _swapk_pico_cb_sem_sch_set_permits(int permits);
@@ -55,6 +82,29 @@ static bool _swapk_pico_cb_sem_sch_take_non_blocking();
 static void _swapk_pico_cb_sem_sch_take_blocking();
 static void _swapk_pico_cb_sem_sch_give();
 
+/* Kernel side spinlocks mask interrupts too, so time them with the
+ * rest of the kernel's masked windows */
+static inline uint32_t _swapk_pico_spin_lock(spin_lock_t *lock, void *site)
+{
+	uint32_t save = spin_lock_blocking(lock);
+
+#if SWAPK_IRQ_TRACE > 0
+	swapk_irq_trace_begin(save, site);
+#else
+	(void) site;
+#endif
+
+	return save;
+}
+
+static inline void _swapk_pico_spin_unlock(spin_lock_t *lock, uint32_t save)
+{
+#if SWAPK_IRQ_TRACE > 0
+	swapk_irq_trace_end(save);
+#endif
+	spin_unlock(lock, save);
+}
+
 swapk_scheduler_t *swapk_pico_scheduler()
 {
 	return &_swapk_pico_scheduler;
@@ -65,8 +115,11 @@ void swapk_pico_init() {
 
 	cbs->poll_event = _swapk_pico_poll_event;
 	cbs->set_alarm = _swapk_pico_set_alarm;
+	cbs->cancel_alarm = _swapk_pico_cancel_alarm;
+	cbs->get_ticks = _swapk_pico_cb_get_ticks;
 	cbs->core_get_id = _swapk_pico_cb_core_get_id;
 	cbs->core_launch = _swapk_pico_cb_core_launch;
+	cbs->core_kick = _swapk_pico_cb_core_kick;
 	cbs->mutex_lock_queue = _swapk_pico_cb_mutex_lock_queue;
 	cbs->mutex_unlock_queue = _swapk_pico_cb_mutex_unlock_queue;
 	cbs->sem_sch_give = _swapk_pico_cb_sem_sch_give;
@@ -75,14 +128,31 @@ void swapk_pico_init() {
 	cbs->sem_sch_take_non_blocking = _swapk_pico_cb_sem_sch_take_non_blocking;
 	cbs->signal_event = _swapk_pico_cb_signal_event;
 
-	_swapk_pico_lock_map_cntr = 0;
-	TAILQ_INIT(&_swapk_pico_lock_maps);
-	TAILQ_INIT(&_swapk_pico_lock_maps_free);
+	/* The queue lock is taken from interrupts and inside SDK lock
+	 * primitives, so it has to be a raw hardware spinlock rather
+	 * than a mutex that would call back into swapkernel */
+	_swapk_pico_queue_lock
+		= spin_lock_instance(spin_lock_claim_unused(true));
+	_swapk_pico_alarm_lock
+		= spin_lock_instance(spin_lock_claim_unused(true));
+
+	for (int i = 0; i < ARRAY_LEN(_swapk_pico_alarms); ++i)
+		_swapk_pico_alarms[i].proc = NULL;
 
 	/* Set up USB as an unmanaged process */
 	swapk_proc_t *tusb = &_swapk_pico_scheduler._unmanaged[0];
-	tusb->core_affinity = 0;
+	tusb->core_mask = SWAPK_CORE_MASK_ANY;
+	tusb->core_preferred = SWAPK_CORE_NONE;
 	tusb->core_id = 0;
+	tusb->core_last = 0;
+	tusb->migrations = 0;
+	tusb->exited = false;
+	tusb->pool_class = SWAPK_POOL_NONE;
+	tusb->result = NULL;
+	tusb->wait_gen = 0;
+	tusb->_waitlist = NULL;
+	tusb->_timed_out = false;
+	swapk_waitlist_init(&tusb->joiners);
 	tusb->entry = NULL;
 	tusb->pid = 10001;
 	tusb->priority = 999;
@@ -92,15 +162,6 @@ void swapk_pico_init() {
 	TAILQ_INSERT_HEAD(&_swapk_pico_scheduler.unmanaged_queue, tusb,
 			  _tailq_entry);
 
-	/* Add all lock maps to the free queue so we can find them
-	 * when we need them */
-	for (int i = 0; i < ARRAY_LEN(_swapk_pico_lock_map_data); ++i) {
-		swapk_pico_lock_map_t *elem = &_swapk_pico_lock_map_data[i];
-		elem->used = false;
-		TAILQ_INSERT_TAIL(&_swapk_pico_lock_maps_free,
-				  elem, _tailq);
-	}
-
 	swapk_scheduler_init(&_swapk_pico_scheduler, &_swapk_pico_cbs);
 
 	/* Use a separate alarm pool for swapkernel */
@@ -119,32 +180,26 @@ void swapk_pico_proc_init(swapk_proc_t *proc, swapk_stack_t *stack,
 			priority);
 }
 
-void swapk_pico_wait(absolute_time_t time,
+bool swapk_pico_wait(absolute_time_t time,
 		     lock_core_t *lock_core, uint32_t save)
 {
-	SWAPK_CORE_ID_T cid = _swapk_pico_scheduler.cb_list->core_get_id();
 	SWAPK_ABSOLUTE_TIME_T ts = _swapk_pico_get_timespec(time);
-
-	/** @todo Should expose the internal swapk API func that does
-	 * this */
-	if (memcmp(&ts, &SWAPK_NOWAIT, sizeof(SWAPK_ABSOLUTE_TIME_T))) {
-		swapk_pico_lock_map_t *lock_map;
-
-		lock_map = _swapk_pico_find_free_lock_map();
-
-		if (!lock_map)
-			panic("Swapk_pico no lock maps available!!!\n");
-
-		if (lock_core == &stdio_usb_mutex.core)
-			lock_map->pid = _swapk_pico_scheduler.unmanaged->pid;
-		else
-			lock_map->pid = _swapk_pico_scheduler.current[cid]->pid;
-
-		lock_map->lock_core = *lock_core;
-		spin_unlock(lock_core->spin_lock, save);
-	}
-
-	swapk_wait(&_swapk_pico_scheduler, ts);
+	volatile uint32_t *word = _swapk_pico_lock_word(lock_core);
+	uint32_t seq = *word;
+
+	spin_unlock(lock_core->spin_lock, save);
+
+	/* The scheduler's own semaphore is taken from inside the
+	 * scheduler, so it can only ever spin. Any notify since we
+	 * read seq makes the futex return at once */
+	if (lock_core != &_swapk_pico_sch_sem.core &&
+	    memcmp(&ts, &SWAPK_NOWAIT, sizeof(SWAPK_ABSOLUTE_TIME_T)))
+		swapk_futex_wait(&_swapk_pico_scheduler, word, seq, ts);
+
+	/* The futex also returns early with no scheduler or on a
+	 * stray wake, so as best_effort_wfe_or_timeout() only report
+	 * a timeout once the deadline has really passed */
+	return time_reached(time);
 }
 
 void swapk_pico_yield_until(absolute_time_t time)
@@ -161,40 +216,22 @@ void swapk_pico_yield_until(absolute_time_t time)
 
 void swapk_pico_notify(lock_core_t *lock_core, uint32_t save)
 {
-	swapk_pico_lock_map_t *lock_map = NULL;
-	swapk_pico_lock_map_t *tlm = NULL;
-	swapk_proc_t *proc = NULL;
-
-	struct _swapk_pico_lock_queue *lq = &_swapk_pico_lock_maps;
-	pid_t pid = 0;
+	volatile uint32_t *word = _swapk_pico_lock_word(lock_core);
 
-	TAILQ_FOREACH_SAFE(lock_map, lq, _tailq, tlm) {
-		/* Free the matching lock map */
-		if (lock_map &&
-		    lock_map->lock_core.spin_lock == lock_core->spin_lock
-		    && lock_map->used) {
-			pid = lock_map->pid;
-			_swapk_pico_free_lock_map(lock_map);
-
-			break;
-		}
-	}
+	/* Still under the spinlock, so a waiter either sees the new
+	 * value or is already on the futex */
+	++*word;
+	spin_unlock(lock_core->spin_lock, save);
 
-	/* Don't preempt if the lock was never registered in the first
-	 * place */
-	if (!lock_map)
+	if (lock_core == &_swapk_pico_sch_sem.core)
 		return;
 
-	/* If part of unmanaged process, return without swapping */
-	TAILQ_FOREACH(proc, &_swapk_pico_scheduler.unmanaged_queue,
-		      _tailq_entry) {	
-		if (pid == proc->pid)
-			return;
-	}
-
-	/* Switch to the waiting process */
-	if (&_swapk_pico_sch_sem.core != lock_core)
-		swapk_notify_pid(&_swapk_pico_scheduler, pid);
+	if (__get_current_exception())
+		swapk_futex_wake_from_isr(&_swapk_pico_scheduler, word,
+					  SWAPK_FUTEX_WAKE_ALL);
+	else
+		swapk_futex_wake(&_swapk_pico_scheduler, word,
+				 SWAPK_FUTEX_WAKE_ALL);
 }
 
 lock_owner_id_t swapk_pico_get_current_pid()
@@ -206,45 +243,15 @@ lock_owner_id_t swapk_pico_get_current_pid()
 		: _swapk_pico_scheduler._system_proc.pid;
 }
 
-swapk_pico_lock_map_t *_swapk_pico_find_free_lock_map()
+SWAPK_ABSOLUTE_TIME_T swapk_pico_time_from_us(uint64_t us)
 {
-	swapk_pico_lock_map_t *lock_map;
-
-	lock_map = TAILQ_FIRST(&_swapk_pico_lock_maps_free);
-
-	/* Will be NULL if no free ones available, so let's not operate
-	 * on the NULL ones */
-	if (lock_map) {
-		/* Mark this one as taken */
-		TAILQ_REMOVE(&_swapk_pico_lock_maps_free, lock_map,
-			     _tailq);
-		TAILQ_INSERT_TAIL(&_swapk_pico_lock_maps, lock_map,
-				  _tailq);
-		lock_map->used = true;
-	}
-
-	return lock_map;
+	return _swapk_pico_get_timespec(from_us_since_boot(us));
 }
 
-swapk_pico_lock_map_t *_swapk_pico_free_lock_map(swapk_pico_lock_map_t *lock_map)
+SWAPK_HOT
+volatile uint32_t *_swapk_pico_lock_word(lock_core_t *lock_core)
 {
-	/* swapk_pico_lock_map_t *elem; */
-	struct _swapk_pico_lock_queue *used, *free;
-
-	used = &_swapk_pico_lock_maps;
-	free = &_swapk_pico_lock_maps_free;
-
-	/* First check that the map is used */
-	/* TAILQ_FOREACH(elem, used, _tailq) */
-		/* if (elem == lock_map) */
-			/* return NULL; /\* NULL if not added to free *\/ */
-
-	/* Remove from used and add to end of free */
-	TAILQ_REMOVE(used, lock_map, _tailq);
-	TAILQ_INSERT_TAIL(free, lock_map, _tailq);
-	lock_map->used = false;
-
-	return lock_map;
+	return &_swapk_pico_lock_seq[spin_lock_get_num(lock_core->spin_lock)];
 }
 
 void _swapk_pico_poll_event(void *arg)
@@ -254,7 +261,22 @@ void _swapk_pico_poll_event(void *arg)
 
 int64_t _swapk_pico_alarm_handler(alarm_id_t id, void *user_data)
 {
-	swapk_notify(&_swapk_pico_scheduler, (swapk_proc_t*) user_data);
+	swapk_pico_alarm_t *alarm = (swapk_pico_alarm_t*) user_data;
+	swapk_proc_t *proc;
+	uint32_t gen;
+	uint32_t save;
+
+	save = _swapk_pico_spin_lock(_swapk_pico_alarm_lock,
+				     __builtin_return_address(0));
+	proc = alarm->proc;
+	gen = alarm->gen;
+	alarm->proc = NULL;
+	_swapk_pico_spin_unlock(_swapk_pico_alarm_lock, save);
+
+	/* Dropped by the scheduler if the wait is already over */
+	if (proc)
+		swapk_notify_timeout_from_isr(&_swapk_pico_scheduler, proc,
+					      gen);
 
 	return 0;
 }
@@ -262,10 +284,80 @@ int64_t _swapk_pico_alarm_handler(alarm_id_t id, void *user_data)
 void _swapk_pico_set_alarm(SWAPK_ABSOLUTE_TIME_T time,
 			   swapk_proc_t *proc)
 {
-	alarm_pool_add_alarm_at(_swapk_pico_alarm_pool,
-				_swapk_pico_get_absolute_time(time),
-				_swapk_pico_alarm_handler,
-				(void*) proc, true);
+	swapk_pico_alarm_t *alarm = NULL;
+	alarm_id_t id;
+	uint32_t save;
+
+	save = _swapk_pico_spin_lock(_swapk_pico_alarm_lock,
+				     __builtin_return_address(0));
+
+	for (int i = 0; i < ARRAY_LEN(_swapk_pico_alarms); ++i)
+		if (!_swapk_pico_alarms[i].proc) {
+			alarm = &_swapk_pico_alarms[i];
+			alarm->proc = proc;
+			alarm->gen = proc->wait_gen;
+			alarm->id = 0;
+			break;
+		}
+
+	_swapk_pico_spin_unlock(_swapk_pico_alarm_lock, save);
+
+	if (!alarm)
+		panic("Swapk_pico no alarms available!!!\n");
+
+	/* May fire, and free the record, before it returns */
+	id = alarm_pool_add_alarm_at(_swapk_pico_alarm_pool,
+				     _swapk_pico_get_absolute_time(time),
+				     _swapk_pico_alarm_handler,
+				     (void*) alarm, true);
+
+	if (id < 0)
+		panic("Swapk_pico alarm pool full!!!\n");
+
+	save = _swapk_pico_spin_lock(_swapk_pico_alarm_lock,
+				     __builtin_return_address(0));
+
+	if (alarm->proc == proc && alarm->gen == proc->wait_gen)
+		alarm->id = id;
+
+	_swapk_pico_spin_unlock(_swapk_pico_alarm_lock, save);
+}
+
+void _swapk_pico_cancel_alarm(swapk_proc_t *proc)
+{
+	swapk_pico_alarm_t *alarm = NULL;
+	alarm_id_t id = 0;
+	uint32_t save;
+
+	save = _swapk_pico_spin_lock(_swapk_pico_alarm_lock,
+				     __builtin_return_address(0));
+
+	for (int i = 0; i < ARRAY_LEN(_swapk_pico_alarms); ++i)
+		if (_swapk_pico_alarms[i].proc == proc &&
+		    _swapk_pico_alarms[i].gen == proc->wait_gen) {
+			alarm = &_swapk_pico_alarms[i];
+			id = alarm->id;
+			break;
+		}
+
+	_swapk_pico_spin_unlock(_swapk_pico_alarm_lock, save);
+
+	/* Either it already fired, or it is firing and the handler
+	 * frees the record */
+	if (!alarm || id <= 0 ||
+	    !alarm_pool_cancel_alarm(_swapk_pico_alarm_pool, id))
+		return;
+
+	save = _swapk_pico_spin_lock(_swapk_pico_alarm_lock,
+				     __builtin_return_address(0));
+	alarm->proc = NULL;
+	_swapk_pico_spin_unlock(_swapk_pico_alarm_lock, save);
+}
+
+SWAPK_HOT
+uint32_t _swapk_pico_cb_get_ticks()
+{
+	return time_us_32();
 }
 
 static struct timespec _swapk_pico_get_timespec(absolute_time_t time)
@@ -296,6 +388,7 @@ static absolute_time_t _swapk_pico_get_absolute_time(struct timespec time)
 	return at;
 }
 
+SWAPK_HOT
 void _swapk_pico_cb_signal_event(void* arg)
 {
 	__sev();
@@ -303,6 +396,7 @@ void _swapk_pico_cb_signal_event(void* arg)
 
 void _swapk_pico_entry_wrapper()
 {
+	_swapk_pico_enable_kick_irq();
 	_swapk_pico_core1_entry(_swapk_pico_core1_arg);
 }
 
@@ -319,6 +413,10 @@ void _swapk_pico_cb_core_launch(SWAPK_CORE_ID_T cid,
 		/* May need to use the raw version and pass a custom
 		 * stack pointer */
 		multicore_launch_core1(_swapk_pico_entry_wrapper);
+
+		/* Launching core 1 talks over the FIFO, so core 0 can
+		 * only start listening for kicks once it is done */
+		_swapk_pico_enable_kick_irq();
 		break;
 	default:
 		panic("Attempted to launch invalid core %d\n", cid);
@@ -326,19 +424,79 @@ void _swapk_pico_cb_core_launch(SWAPK_CORE_ID_T cid,
 	}
 }
 
+SWAPK_HOT
 SWAPK_CORE_ID_T _swapk_pico_cb_core_get_id()
 {
 	return (SWAPK_CORE_ID_T) get_core_num();
 }
 
+SWAPK_HOT
+void _swapk_pico_cb_core_kick(SWAPK_CORE_ID_T cid)
+{
+	/* The FIFO only reaches the other core */
+	if (cid == get_core_num())
+		return;
+
+	_swapk_pico_kick_pending[cid] = true;
+	SWAPK_MEMORY_BARRIER();
+
+	/* Full means words the other core hasn't read yet, so its
+	 * interrupt is already raised and will see the flag. Never
+	 * wait for room, as we may be in an interrupt ourselves */
+	if (!multicore_fifo_wready())
+		return;
+
+	sio_hw->fifo_wr = cid;
+	__sev();
+}
+
+SWAPK_HOT
+void _swapk_pico_fifo_irq_handler()
+{
+	SWAPK_CORE_ID_T cid = get_core_num();
+
+	/* Any number of queued kicks collapse into one reschedule */
+	multicore_fifo_drain();
+	multicore_fifo_clear_irq();
+
+	/* A kick set after this finds the FIFO drained and raises
+	 * the interrupt again */
+	if (!_swapk_pico_kick_pending[cid])
+		return;
+
+	_swapk_pico_kick_pending[cid] = false;
+	SWAPK_MEMORY_BARRIER();
+	swapk_core_kicked(&_swapk_pico_scheduler);
+}
+
+void _swapk_pico_enable_kick_irq()
+{
+	unsigned int irq = get_core_num() ? SIO_IRQ_PROC1 : SIO_IRQ_PROC0;
+
+	/* Exclusive on purpose: the handler drains the FIFO, so any
+	 * other user of it would lose its messages */
+	multicore_fifo_clear_irq();
+	irq_set_exclusive_handler(irq, _swapk_pico_fifo_irq_handler);
+	irq_set_enabled(irq, true);
+}
+
+SWAPK_HOT
 void _swapk_pico_cb_mutex_lock_queue()
 {
-	mutex_enter_blocking(&_swapk_pico_mtx);
+	/* The kernel renames the site after its own caller */
+	uint32_t save = _swapk_pico_spin_lock(_swapk_pico_queue_lock,
+					      __builtin_return_address(0));
+
+	/* Only the owning core touches its slot, and the lock is
+	 * never nested, so this is safe to stash per core */
+	_swapk_pico_queue_lock_save[get_core_num()] = save;
 }
 
+SWAPK_HOT
 void _swapk_pico_cb_mutex_unlock_queue()
 {
-	mutex_exit(&_swapk_pico_mtx);
+	_swapk_pico_spin_unlock(_swapk_pico_queue_lock,
+				_swapk_pico_queue_lock_save[get_core_num()]);
 }
 
 void _swapk_pico_cb_sem_sch_set_permits(int permits)
@@ -346,6 +504,7 @@ void _swapk_pico_cb_sem_sch_set_permits(int permits)
 	sem_init(&_swapk_pico_sch_sem, permits, permits);
 }
 
+SWAPK_HOT
 bool _swapk_pico_cb_sem_sch_take_non_blocking()
 {
 	return sem_acquire_block_until(&_swapk_pico_sch_sem,
@@ -357,6 +516,7 @@ void _swapk_pico_cb_sem_sch_take_blocking()
 	sem_acquire_blocking(&_swapk_pico_sch_sem);
 }
 
+SWAPK_HOT
 void _swapk_pico_cb_sem_sch_give()
 {
 	sem_release(&_swapk_pico_sch_sem);
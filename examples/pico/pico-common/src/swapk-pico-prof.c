@@ -0,0 +1,57 @@
+/**
+ * @file swapk-pico-prof.c
+ * @author Tyler J. Anderson
+ * @brief SysTick driven sampling profiler on the Pico SDK
+ */
+
+#include "swapk-pico-prof.h"
+#include "swapk-pico-integration.h"
+#include "swapk_prof.h"
+
+#include "hardware/clocks.h"
+#include "hardware/exception.h"
+#include "hardware/structs/systick.h"
+
+#include <stdio.h>
+
+/* SysTick's reload register is 24 bits */
+#define SWAPK_PICO_PROF_RELOAD_MAX 0x00ffffff
+
+void swapk_pico_prof_init()
+{
+	swapk_prof_init(swapk_pico_scheduler());
+	exception_set_exclusive_handler(SYSTICK_EXCEPTION, swapk_prof_isr);
+}
+
+void swapk_pico_prof_start(uint32_t hz)
+{
+	uint32_t reload = clock_get_hz(clk_sys) / (hz ? hz : 1);
+
+	if (reload > SWAPK_PICO_PROF_RELOAD_MAX)
+		reload = SWAPK_PICO_PROF_RELOAD_MAX;
+
+	systick_hw->csr = 0;
+	systick_hw->rvr = reload ? reload - 1 : 0;
+	systick_hw->cvr = 0;
+	systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS |
+		M0PLUS_SYST_CSR_TICKINT_BITS |
+		M0PLUS_SYST_CSR_ENABLE_BITS;
+}
+
+void swapk_pico_prof_stop()
+{
+	systick_hw->csr = 0;
+}
+
+void swapk_pico_prof_dump()
+{
+	uint32_t words[8 * SWAPK_PROF_SAMPLE_WORDS];
+	const size_t max = sizeof(words) / sizeof(words[0]);
+	size_t n;
+
+	for (SWAPK_CORE_ID_T cid = 0; cid < SWAPK_HARDWARE_THREADS; ++cid)
+		while ((n = swapk_prof_read(cid, words, max)))
+			for (size_t i = 0; i < n; ++i)
+				printf("%08lx%c", (unsigned long) words[i],
+				       i + 1 < n ? ' ' : '\n');
+}
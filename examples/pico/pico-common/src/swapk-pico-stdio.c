@@ -0,0 +1,218 @@
+/**
+ * @file swapk-pico-stdio.c
+ * @author Tyler J. Anderson
+ * @brief Buffered stdout for swapkernel projects on the Pico SDK
+ */
+
+#include "swapk-pico-stdio.h"
+#include "swapk-pico-integration.h"
+
+#include "pico/stdio.h"
+#include "pico/stdio/driver.h"
+#include "pico/stdio_usb.h"
+
+#if SWAPK_PICO_STDIO_BUFFER & (SWAPK_PICO_STDIO_BUFFER - 1)
+#error "SWAPK_PICO_STDIO_BUFFER must be a power of two"
+#endif
+
+/* One producer per core, as printing holds the scheduler lock, and
+ * the writer as the only consumer */
+typedef struct {
+	char data[SWAPK_PICO_STDIO_BUFFER];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	uint32_t dropped;
+} swapk_pico_stdio_ring_t;
+
+static swapk_pico_stdio_ring_t _swapk_pico_stdio_rings[NUM_CORES];
+static swapk_proc_t _swapk_pico_stdio_proc;
+static volatile uint32_t _swapk_pico_stdio_kick;
+static volatile bool _swapk_pico_stdio_sleeping;
+
+static void _swapk_pico_stdio_out_chars(const char *buf, int len);
+static void _swapk_pico_stdio_out_flush();
+static int _swapk_pico_stdio_in_chars(char *buf, int len);
+static void _swapk_pico_stdio_wake();
+static bool _swapk_pico_stdio_empty();
+static void _swapk_pico_stdio_sleep(swapk_scheduler_t *sch,
+				    SWAPK_ABSOLUTE_TIME_T time, bool idle);
+static void *_swapk_pico_stdio_entry(void *arg);
+
+static stdio_driver_t _swapk_pico_stdio_driver = {
+	.out_chars = _swapk_pico_stdio_out_chars,
+	.out_flush = _swapk_pico_stdio_out_flush,
+	.in_chars = _swapk_pico_stdio_in_chars,
+#if PICO_STDIO_ENABLE_CRLF_SUPPORT
+	.crlf_enabled = PICO_STDIO_DEFAULT_CRLF
+#endif
+};
+
+void swapk_pico_stdio_init(swapk_stack_t *stack, int priority)
+{
+	for (int i = 0; i < NUM_CORES; ++i) {
+		_swapk_pico_stdio_rings[i].head = 0;
+		_swapk_pico_stdio_rings[i].tail = 0;
+		_swapk_pico_stdio_rings[i].dropped = 0;
+	}
+
+	_swapk_pico_stdio_kick = 0;
+	_swapk_pico_stdio_sleeping = false;
+
+	swapk_pico_proc_init(&_swapk_pico_stdio_proc, stack,
+			     _swapk_pico_stdio_entry, priority);
+
+	/* The writer is now the only one talking to USB CDC */
+	stdio_set_driver_enabled(&stdio_usb, false);
+	stdio_set_driver_enabled(&_swapk_pico_stdio_driver, true);
+}
+
+uint32_t swapk_pico_stdio_dropped()
+{
+	uint32_t dropped = 0;
+
+	for (int i = 0; i < NUM_CORES; ++i)
+		dropped += _swapk_pico_stdio_rings[i].dropped;
+
+	return dropped;
+}
+
+SWAPK_HOT
+void _swapk_pico_stdio_out_chars(const char *buf, int len)
+{
+	swapk_scheduler_t *sch = swapk_pico_scheduler();
+	swapk_pico_stdio_ring_t *ring;
+	uint32_t head;
+	uint32_t used;
+	bool wake;
+	int n;
+
+	/* Nothing else on this core can touch its ring until we are
+	 * done */
+	swapk_sched_lock(sch);
+	ring = &_swapk_pico_stdio_rings[get_core_num()];
+	head = ring->head;
+	used = head - ring->tail;
+	n = SWAPK_PICO_STDIO_BUFFER - used < (uint32_t) len
+		? (int) (SWAPK_PICO_STDIO_BUFFER - used)
+		: len;
+
+	for (int i = 0; i < n; ++i)
+		ring->data[(head + i) & (SWAPK_PICO_STDIO_BUFFER - 1)]
+			= buf[i];
+
+	SWAPK_MEMORY_BARRIER();
+	ring->head = head + n;
+	ring->dropped += len - n;
+	SWAPK_MEMORY_BARRIER();
+
+	/* Read the tail after publishing, so either the writer sees
+	 * our bytes before it blocks or we see it drained everything
+	 * before them and wake it. A busy writer finds the rest on
+	 * its own unless we pass half full */
+	wake = n && (ring->tail == head ||
+		     used + n >= SWAPK_PICO_STDIO_BUFFER / 2);
+	swapk_sched_unlock(sch);
+
+	if (wake)
+		_swapk_pico_stdio_wake();
+}
+
+void _swapk_pico_stdio_out_flush()
+{
+	_swapk_pico_stdio_wake();
+}
+
+int _swapk_pico_stdio_in_chars(char *buf, int len)
+{
+	return stdio_usb.in_chars(buf, len);
+}
+
+SWAPK_HOT
+void _swapk_pico_stdio_wake()
+{
+	++_swapk_pico_stdio_kick;
+	SWAPK_MEMORY_BARRIER();
+
+	if (_swapk_pico_stdio_sleeping)
+		swapk_futex_wake(swapk_pico_scheduler(),
+				 &_swapk_pico_stdio_kick, 1);
+}
+
+bool _swapk_pico_stdio_empty()
+{
+	for (int i = 0; i < NUM_CORES; ++i)
+		if (_swapk_pico_stdio_rings[i].head
+		    != _swapk_pico_stdio_rings[i].tail)
+			return false;
+
+	return true;
+}
+
+/* Block until kicked or time. Sleeping is raised before the kick
+ * count is read, so a wake is either seen by the futex or sees us
+ * sleeping. When idle, only block if there is still nothing to
+ * send */
+void _swapk_pico_stdio_sleep(swapk_scheduler_t *sch,
+			     SWAPK_ABSOLUTE_TIME_T time, bool idle)
+{
+	uint32_t kick;
+
+	_swapk_pico_stdio_sleeping = true;
+	SWAPK_MEMORY_BARRIER();
+	kick = _swapk_pico_stdio_kick;
+
+	if (!idle || _swapk_pico_stdio_empty())
+		swapk_futex_wait(sch, &_swapk_pico_stdio_kick, kick, time);
+
+	_swapk_pico_stdio_sleeping = false;
+}
+
+void *_swapk_pico_stdio_entry(void *arg)
+{
+	swapk_scheduler_t *sch = swapk_pico_scheduler();
+
+	for (;;) {
+		/* Nothing wakes us until a print finds its buffer
+		 * empty */
+		_swapk_pico_stdio_sleep(sch, SWAPK_FOREVER, true);
+
+		if (_swapk_pico_stdio_empty())
+			continue;
+
+		/* Let the rest of a burst catch up so it goes out in
+		 * one batch, unless a buffer passes half full */
+		_swapk_pico_stdio_sleep(sch,
+					swapk_pico_time_from_us(time_us_64()
+								+ SWAPK_PICO_STDIO_FLUSH_US),
+					false);
+
+		for (int i = 0; i < NUM_CORES; ++i) {
+			swapk_pico_stdio_ring_t *ring
+				= &_swapk_pico_stdio_rings[i];
+			uint32_t tail = ring->tail;
+			uint32_t head = ring->head;
+
+			SWAPK_MEMORY_BARRIER();
+
+			/* At most two runs, either side of the wrap */
+			while (tail != head) {
+				uint32_t off = tail & (SWAPK_PICO_STDIO_BUFFER - 1);
+				uint32_t n = head - tail;
+
+				if (n > SWAPK_PICO_STDIO_BUFFER - off)
+					n = SWAPK_PICO_STDIO_BUFFER - off;
+
+				stdio_usb.out_chars(&ring->data[off], n);
+				tail += n;
+			}
+
+			SWAPK_MEMORY_BARRIER();
+			ring->tail = tail;
+		}
+
+		if (stdio_usb.out_flush)
+			stdio_usb.out_flush();
+	}
+
+	return arg;
+}
@@ -0,0 +1,72 @@
+#include "swapk-pico-integration.h"
+
+#include "pico/stdlib.h"
+
+#include <stdio.h>
+
+#define SWAPK_STACK_SIZE_BENCH 1024
+
+#define BENCH_YIELDS 10000
+
+SWAPK_DEFINE_STACK(stackping, SWAPK_STACK_SIZE_BENCH);
+SWAPK_DEFINE_STACK(stackpong, SWAPK_STACK_SIZE_BENCH);
+
+static swapk_proc_t procping;
+static swapk_proc_t procpong;
+
+static void *ping_entry(void*);
+static void *pong_entry(void*);
+
+void *ping_entry(void *arg)
+{
+	swapk_scheduler_t *sch = swapk_pico_scheduler();
+	unsigned long elapsed;
+
+	stdio_usb_init();
+
+	while(!stdio_usb_connected()) {
+		sleep_ms(100);
+	}
+
+	for (;;) {
+		uint32_t start = time_us_32();
+
+		for (int i = 0; i < BENCH_YIELDS; ++i)
+			swapk_yield(sch);
+
+		elapsed = time_us_32() - start;
+
+		/* Every yield hands over to pong and back again */
+		printf("%s: %d yields in %lu us, %lu ns per switch\n",
+		       SWAPK_COOPERATIVE_ONLY > 0 ? "cooperative" : "preemptive",
+		       BENCH_YIELDS, elapsed,
+		       elapsed * 1000 / (2 * BENCH_YIELDS));
+
+		sleep_ms(1000);
+	}
+
+	return arg;
+}
+
+void *pong_entry(void *arg)
+{
+	swapk_scheduler_t *sch = swapk_pico_scheduler();
+
+	for (;;)
+		swapk_yield(sch);
+
+	return arg;
+}
+
+int main()
+{
+	swapk_pico_init();
+
+	/* Cooperative priority and one core, so each yield goes
+	 * straight to the other process */
+	swapk_pico_proc_init(&procping, &stackping, ping_entry, -2);
+	swapk_proc_set_affinity(&procping, SWAPK_CORE_MASK(0), 0);
+	swapk_pico_proc_init(&procpong, &stackpong, pong_entry, -2);
+	swapk_proc_set_affinity(&procpong, SWAPK_CORE_MASK(0), 0);
+	swapk_pico_start();
+}
@@ -12,19 +12,66 @@
 
 #include "queue.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * @defgroup swapk_api Swapkernel API
  * @{
  */
 
 #ifndef SWAPK_SYSTEM_STACK_SIZE
+/** @brief Stack for the scheduler pass and system calls
+ *
+ * Callbacks run here too, so integrations with deep callbacks may
+ * need more. No high-water mark has been taken across
+ * configurations yet, so the default stays at 4 KiB. Read
+ * swapk_system_stack_used() on target, and leave a margin over it,
+ * before lowering this.
+ */
 #define SWAPK_SYSTEM_STACK_SIZE (4 * 1024)
 #endif
 
 #ifndef SWAPK_SLEEP_STACK_SIZE
+/** @brief Stack for each core's idle process
+ *
+ * Holds the idle loop's calls into swapk_yield(), the queue lock and
+ * poll_event callbacks, and the histogram and trace hooks when they
+ * are enabled. An interrupt taken while the core is idle also pushes
+ * its exception frame here, as the idle process runs on the PSP. The
+ * default stays at 4 KiB until it has been measured. Read
+ * swapk_sleep_stack_used() on target, and leave a margin over it,
+ * before lowering this.
+ */
 #define SWAPK_SLEEP_STACK_SIZE (4 * 1024)
 #endif
 
+#ifndef SWAPK_CALL_ARGS_MAX
+/** @brief Size of the system call argument list */
+#define SWAPK_CALL_ARGS_MAX 4
+#endif
+
+#ifndef SWAPK_ISR_WAKE_SLOTS
+/** @brief Wakes each core can hold from interrupts between passes,
+ * a power of two no larger than 128 */
+#define SWAPK_ISR_WAKE_SLOTS 8
+#endif
+
+#ifndef SWAPK_FUTEX_BUCKETS
+/** @brief Wait lists futex addresses are hashed into, a power of
+ * two */
+#define SWAPK_FUTEX_BUCKETS 16
+#endif
+
+/** @brief Wake count for swapk_futex_wake() meaning every waiter */
+#define SWAPK_FUTEX_WAKE_ALL INT32_MAX
+
+#ifndef SWAPK_STACK_PAINT
+/** @brief Byte stacks are filled with to measure their use */
+#define SWAPK_STACK_PAINT 0xa5
+#endif
+
 #ifndef SWAPK_SYSTEM_PROC_PRIORITY
 #define SWAPK_SYSTEM_PROC_PRIORITY -1
 #endif
@@ -57,6 +104,114 @@
 #define SWAPK_UNMANAGED_PROCS 0
 #endif
 
+#ifndef SWAPK_COOPERATIVE_ONLY
+/** @brief Set greater than 0 to build without preemption
+ *
+ * Processes only give up the core by yielding or waiting, whatever
+ * their priority. Switches become plain calls that save and restore
+ * the callee-saved registers, and the PendSV and SVC handlers and
+ * preemption bookkeeping are left out.
+ *
+ * To weigh the two modes on a board, build the switch-bench
+ * example. example-switch-bench and example-switch-bench-coop print
+ * the time per switch, and the swapk-footprint target lists their
+ * flash and RAM side by side. No figures are kept here, as they
+ * depend on the clock, toolchain and SDK version.
+ */
+#define SWAPK_COOPERATIVE_ONLY 0
+#endif
+
+#ifndef SWAPK_PROC_HISTOGRAMS
+/** @brief Set greater than 0 to keep per process timing histograms
+ *
+ * Each process counts how long it took to be switched in after
+ * being readied, and how long it ran each time it was, in log2
+ * buckets of get_ticks units. Costs a tick read and a few stores per
+ * switch, and nothing is counted while get_ticks is NULL.
+ */
+#define SWAPK_PROC_HISTOGRAMS 0
+#endif
+
+#ifndef SWAPK_IRQ_TRACE
+/** @brief Set greater than 0 to time interrupts-masked windows
+ *
+ * swapk_irq_save() and swapk_irq_restore(), the PendSV switch and
+ * ports that call swapk_irq_trace_begin() and swapk_irq_trace_end()
+ * record the longest window each core spent masked, and where it
+ * started, in get_ticks units. Only outermost windows are timed.
+ */
+#define SWAPK_IRQ_TRACE 0
+#endif
+
+#ifndef SWAPK_PROC_HIST_BUCKETS
+/** @brief Buckets per histogram
+ *
+ * Bucket 0 counts samples of 0 ticks, bucket n counts
+ * [2^(n-1), 2^n) ticks and the last bucket also takes everything
+ * longer.
+ */
+#define SWAPK_PROC_HIST_BUCKETS 16
+#endif
+
+#ifndef SWAPK_RAM_HOT_PATHS
+/** @brief Set greater than 0 to run the scheduler hot paths from RAM
+ *
+ * Functions on the context switch and wakeup paths are marked
+ * SWAPK_HOT and placed in SWAPK_HOT_SECTION, which the linker script
+ * must copy to RAM. kernel.S is placed in the same way.
+ */
+#define SWAPK_RAM_HOT_PATHS 0
+#endif
+
+#ifndef SWAPK_HOT_SECTION
+#define SWAPK_HOT_SECTION ".time_critical.swapk"
+#endif
+
+#ifndef SWAPK_HOT
+#if SWAPK_RAM_HOT_PATHS > 0
+#define SWAPK_HOT __attribute__((section(SWAPK_HOT_SECTION)))
+#else
+#define SWAPK_HOT
+#endif
+#endif
+
+#ifndef SWAPK_EXTERNAL_SLEEP_STACKS
+/** @brief Set greater than 0 to supply the idle process stacks
+ *
+ * The integration then defines swapk_sleep_stack_data, each
+ * SWAPK_SLEEP_STACK_SIZE bytes, so that every core's stack can be
+ * placed in its own memory bank.
+ */
+#define SWAPK_EXTERNAL_SLEEP_STACKS 0
+#endif
+
+#ifndef SWAPK_POOL_SMALL_PROCS
+/** @brief Pooled processes with small stacks for swapk_proc_spawn()
+ *
+ * Spawned processes come from a fixed-block pool held in the
+ * scheduler, split into a small and a large stack size class. A
+ * spawn takes a block from the smallest class that fits and an
+ * exited process gives it back, both in constant time. Both
+ * classes default to empty, which disables spawning.
+ */
+#define SWAPK_POOL_SMALL_PROCS 0
+#endif
+
+#ifndef SWAPK_POOL_SMALL_STACK_SIZE
+#define SWAPK_POOL_SMALL_STACK_SIZE 1024
+#endif
+
+#ifndef SWAPK_POOL_LARGE_PROCS
+/** @brief Pooled processes with large stacks for swapk_proc_spawn() */
+#define SWAPK_POOL_LARGE_PROCS 0
+#endif
+
+#ifndef SWAPK_POOL_LARGE_STACK_SIZE
+#define SWAPK_POOL_LARGE_STACK_SIZE (4 * 1024)
+#endif
+
+#define SWAPK_POOL_PROCS (SWAPK_POOL_SMALL_PROCS + SWAPK_POOL_LARGE_PROCS)
+
 #ifndef SWAPK_ABSOLUTE_TIME_T
 
 #include <time.h>
@@ -76,8 +231,28 @@
 #define SWAPK_CORE_ID_T uint8_t
 #endif
 
+#ifndef SWAPK_CORE_MASK_T
+#define SWAPK_CORE_MASK_T uint32_t
+#endif
+
+/** @brief Core mask with only core @p cid set */
+#define SWAPK_CORE_MASK(cid) ((SWAPK_CORE_MASK_T)1 << (cid))
+#define SWAPK_CORE_MASK_ANY ((SWAPK_CORE_MASK_T)-1)
+#define SWAPK_CORE_NONE (-1)
+
+#ifndef SWAPK_MEMORY_BARRIER
+/** @brief Order memory accesses seen by the other core */
+#define SWAPK_MEMORY_BARRIER() __asm volatile ("dmb" : : : "memory")
+#endif
+
 #define SWAPK_INVALID_PID ((swapk_pid_t)-1)
 
+/* Process pool size classes */
+#define SWAPK_POOL_NONE		-1
+#define SWAPK_POOL_SMALL	0
+#define SWAPK_POOL_LARGE	1
+#define SWAPK_POOL_CLASSES	2
+
 /* System events */
 #define SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH	0x00000001
 #define SWAPK_SYSTEM_EVENT_SCH_AVAILABLE	0x00000002
@@ -99,6 +274,10 @@
 extern struct timespec swapk_empty_time;
 extern struct timespec swapk_full_time;
 
+#if SWAPK_EXTERNAL_SLEEP_STACKS > 0
+extern uint8_t *const swapk_sleep_stack_data[SWAPK_HARDWARE_THREADS];
+#endif
+
 typedef uint16_t swapk_pid_t;
 typedef void *(*swapk_entry)(void*);
 
@@ -108,6 +287,16 @@ typedef struct {
 	unsigned int stacksize;
 } swapk_stack_t;
 
+TAILQ_HEAD(swapk_wait_queue, swapk_proc_node);
+
+/** @brief Processes blocked until another process wakes them */
+typedef struct {
+	struct swapk_wait_queue procs;
+
+	/** Bumped by every notify, see swapk_waitlist_prepare() */
+	uint32_t seq;
+} swapk_waitlist_t;
+
 typedef struct swapk_proc_node {
 	swapk_stack_t *stack;
 	swapk_entry entry;
@@ -116,11 +305,17 @@ typedef struct swapk_proc_node {
 	swapk_pid_t pid;
 
 	/**
-	 * <0: Always operate on -1 * (core_id + 1)
-	 * 0: Operate on any core (Default)
-	 * >0: Always operate on core_id + 1
+	 * Cores the process may run on, built with
+	 * SWAPK_CORE_MASK(). Defaults to SWAPK_CORE_MASK_ANY
 	 */
-	int core_affinity;
+	SWAPK_CORE_MASK_T core_mask;
+
+	/**
+	 * Core the process would rather run on when it has a
+	 * choice. SWAPK_CORE_NONE (default) prefers whichever core
+	 * it ran on last
+	 */
+	int core_preferred;
 
 	/**
 	 * The core_id process is running on. <0 if
@@ -128,7 +323,59 @@ typedef struct swapk_proc_node {
 	 */
 	int core_id;
 
+	/** The core the process last ran on, <0 if never run */
+	int core_last;
+
+	/** Times the process was switched in on a new core */
+	uint32_t migrations;
+
+	/** The process has exited and will never be scheduled again */
+	bool exited;
+
+	/** Pool size class the process came from, or SWAPK_POOL_NONE */
+	int8_t pool_class;
+
+	/** Value returned by the entry or passed to swapk_proc_exit() */
+	void *result;
+
+	/** Processes blocked in swapk_join() on this one */
+	swapk_waitlist_t joiners;
+
+	/**
+	 * Bumped when a wait with a timeout ends. The set_alarm
+	 * callback keeps the value it saw for
+	 * swapk_notify_timeout_from_isr()
+	 */
+	uint32_t wait_gen;
+
+	/**
+	 * swapk_sched_lock() nesting. Kept on the process rather
+	 * than the core so it moves with the process if it migrates
+	 */
+	uint8_t sched_lock_depth;
+
+#if SWAPK_PROC_HISTOGRAMS > 0
+	/** Ticks from being readied to being switched in */
+	uint32_t hist_latency[SWAPK_PROC_HIST_BUCKETS];
+
+	/** Ticks run each time the process was switched in */
+	uint32_t hist_run[SWAPK_PROC_HIST_BUCKETS];
+#endif
+
+	/* Private members */
+	swapk_waitlist_t *_waitlist;
+	void *_wait_data;
+	bool _timed_out;
+	bool _sched_deferred;
+#if SWAPK_PROC_HISTOGRAMS > 0
+	bool _ready_stamped;
+	bool _run_stamped;
+	uint32_t _ready_tick;
+	uint32_t _run_tick;
+#endif
+
 	TAILQ_ENTRY(swapk_proc_node) _tailq_entry;
+	TAILQ_ENTRY(swapk_proc_node) _wait_entry;
 } swapk_proc_t;
 
 TAILQ_HEAD(swapk_proc_queue, swapk_proc_node);
@@ -158,26 +405,101 @@ typedef struct {
 
 typedef int (*swapk_system_call)(int argc, void **argv);
 
+/** @brief Per core scheduler counters, counted on the calling core */
+typedef struct {
+	/** Wakeups handed to an idle core */
+	uint32_t idle_wakeups;
+
+	/** Wakeups that didn't outrank anything running */
+	uint32_t preempts_avoided;
+
+	/** Yields that returned early as nothing else should run */
+	uint32_t yields_skipped;
+
+	/** Interrupt wakes that found the ring full */
+	uint32_t isr_wake_overflows;
+
+	/** Alarms cancelled as the wait ended early */
+	uint32_t alarms_cancelled;
+
+	/** Alarms that fired after their wait ended and were dropped */
+	uint32_t stale_timeouts;
+
+	/** Processes switched in */
+	uint32_t context_switches;
+
+	/** Scheduler passes, whether or not they picked anything */
+	uint32_t sched_passes;
+
+	/** Process queue sorts */
+	uint32_t sorts;
+
+	/** Trips to the scheduler forced by preemption or a kick */
+	uint32_t preemptions;
+
+	/** Trips to the scheduler asked for with swapk_yield() */
+	uint32_t yields;
+
+	/** Yields that found the scheduler semaphore taken */
+	uint32_t sem_spins;
+
+	/** Time spent waiting for the scheduler, in get_ticks units */
+	uint32_t sched_wait_ticks;
+
+	/** System calls made through the SVC */
+	uint32_t svc_calls;
+} swapk_sched_stats_t;
+
 typedef struct {
 	void (*poll_event)(void*);
 	void (*signal_event)(void*);
 	void (*set_alarm)(SWAPK_ABSOLUTE_TIME_T, swapk_proc_t*);
 
+	/**
+	 * Free running timestamp for log records and the scheduler
+	 * wait counter, in any unit the reader knows. If NULL, will
+	 * be ignored
+	 */
+	uint32_t (*get_ticks)(void);
+
+	/**
+	 * Drop the alarm set for the process's current wait, which
+	 * ended before it fired. Must cope with the alarm firing
+	 * anyway. If NULL, will be ignored
+	 */
+	void (*cancel_alarm)(swapk_proc_t*);
+
 	/* If NULL, will be ignored */
 	void (*core_launch)(SWAPK_CORE_ID_T, swapk_entry, void*);
+
+	/* Not called when SWAPK_HARDWARE_THREADS is 1 */
 	SWAPK_CORE_ID_T (*core_get_id)();
 
-	/* Not sure if this is needed, the scheduler semaphore may
-	 * solve this problem. The idea is to prevent simultaneous
-	 * pushes and pops of the task queue, but all these pushes
-	 * and pops should probably be moved to the scheduler. */
+	/**
+	 * Interrupt only the given core so it reschedules (e.g. the
+	 * inter-core FIFO IRQ on rp2040 or a signal on a hosted
+	 * port). The port's handler must call swapk_core_kicked() on
+	 * the target core. Kicking the calling core may be a
+	 * no-op. If NULL, signal_event will be broadcast instead
+	 */
+	void (*core_kick)(SWAPK_CORE_ID_T);
+
+	/**
+	 * Short critical section around the process queue. Taken by
+	 * every push, pop, sort and ready so a core can ready or
+	 * wake a process without holding the scheduler
+	 * semaphore. Must be safe to call from an interrupt and is
+	 * never nested, so a hardware spinlock with interrupts
+	 * masked is a good fit. If NULL, will be ignored
+	 */
 	void (*mutex_lock_queue)(void);
 	void (*mutex_unlock_queue)(void);
 
 	/**
 	 * Sch can only be on one core at a time. Semaphore required
 	 * to ensure this. In the mean time the core will switch to
-	 * the sleep job
+	 * the sleep job. Never called, and may be NULL, when
+	 * SWAPK_HARDWARE_THREADS is 1
 	 */
 	void (*sem_sch_set_permits)(int);
 	bool (*sem_sch_take_non_blocking)();
@@ -196,6 +518,7 @@ typedef struct {
 #endif /* #if SWAPK_UNMANAGED_PROCS > 0 */
 	swapk_callbacks_t *cb_list;
 	swapk_event_t events[SWAPK_HARDWARE_THREADS];
+	swapk_sched_stats_t stats[SWAPK_HARDWARE_THREADS];
 	uint16_t proc_cnt;
 
 	/* Private members */
@@ -203,17 +526,40 @@ typedef struct {
 	uint8_t _system_stack_data[SWAPK_SYSTEM_STACK_SIZE];
 	swapk_stack_t _system_stack;
 	swapk_proc_t _sleep_proc[SWAPK_HARDWARE_THREADS];
+#if SWAPK_EXTERNAL_SLEEP_STACKS == 0
 	uint8_t _sleep_stack_data[SWAPK_HARDWARE_THREADS][SWAPK_SLEEP_STACK_SIZE];
+#endif
 	swapk_stack_t _sleep_stack[SWAPK_HARDWARE_THREADS];
+#if SWAPK_POOL_PROCS > 0
+	struct swapk_proc_queue _pool_free[SWAPK_POOL_CLASSES];
+	swapk_proc_t _pool_proc[SWAPK_POOL_PROCS];
+	swapk_stack_t _pool_stack[SWAPK_POOL_PROCS];
+#if SWAPK_POOL_SMALL_PROCS > 0
+	uint8_t _pool_small_stack_data[SWAPK_POOL_SMALL_PROCS]
+		[SWAPK_POOL_SMALL_STACK_SIZE];
+#endif
+#if SWAPK_POOL_LARGE_PROCS > 0
+	uint8_t _pool_large_stack_data[SWAPK_POOL_LARGE_PROCS]
+		[SWAPK_POOL_LARGE_STACK_SIZE];
+#endif
+#endif /* #if SWAPK_POOL_PROCS > 0 */
 	swapk_system_call _call;
 	int _call_argc;
-	void *_call_argv[32];
+	void *_call_argv[SWAPK_CALL_ARGS_MAX];
 	int _call_result;
 	bool _call_complete;
 	pid_t _call_calling_pid;
 	swapk_proc_t *_current[SWAPK_HARDWARE_THREADS];
 	swapk_proc_t *_next[SWAPK_HARDWARE_THREADS];
 	swapk_proc_t *_last[SWAPK_HARDWARE_THREADS];
+	swapk_proc_t *_isr_wake[SWAPK_HARDWARE_THREADS][SWAPK_ISR_WAKE_SLOTS];
+	volatile uint8_t _isr_wake_head[SWAPK_HARDWARE_THREADS];
+	volatile uint8_t _isr_wake_tail[SWAPK_HARDWARE_THREADS];
+	volatile bool _isr_wake_pending[SWAPK_HARDWARE_THREADS];
+	swapk_waitlist_t _futex[SWAPK_FUTEX_BUCKETS];
+#if SWAPK_COOPERATIVE_ONLY > 0
+	bool _sch_release[SWAPK_HARDWARE_THREADS];
+#endif
 } swapk_scheduler_t;
 
 void swapk_scheduler_init(swapk_scheduler_t *sch,
@@ -229,8 +575,45 @@ void swapk_yield(swapk_scheduler_t *sch);
 /** @brief Preempt a preemptable process and return to system */
 void swapk_preempt(swapk_scheduler_t *sch);
 
+/**
+ * @brief Keep the scheduler from preempting the calling process
+ *
+ * Nests, and counts on the calling process, so it still holds if
+ * the process is moved to another core. Preemption requested while
+ * locked, from a wake or a kick, is held until the outermost
+ * swapk_sched_unlock(). Interrupts still run. Do not wait or block
+ * while holding the lock.
+ */
+void swapk_sched_lock(swapk_scheduler_t *sch);
+
+/** @brief Undo one swapk_sched_lock(), running any held preemption */
+void swapk_sched_unlock(swapk_scheduler_t *sch);
+
+/**
+ * @brief Copy the scheduler counters of one core
+ *
+ * Lock free, so counters still moving on that core may be a count
+ * apart from each other. Pass SWAPK_CORE_NONE to sum every core.
+ */
+void swapk_sched_stats_snapshot(swapk_scheduler_t *sch,
+				SWAPK_CORE_ID_T cid,
+				swapk_sched_stats_t *out);
+
+/** @brief Zero the counters of one core, or all with SWAPK_CORE_NONE */
+void swapk_sched_stats_reset(swapk_scheduler_t *sch, SWAPK_CORE_ID_T cid);
+
 void swapk_call_scheduler_available(swapk_scheduler_t *sch);
 
+/**
+ * @brief Handle a reschedule request from another core
+ *
+ * Called by the port from the interrupt raised by the core_kick
+ * callback. Preempts the current process straight away if it is
+ * preemptable and the scheduler is free, otherwise leaves the
+ * request pending for the next scheduling pass.
+ */
+void swapk_core_kicked(swapk_scheduler_t *sch);
+
 /** @brief Sort processes in the scheduler's queue */
 void swapk_scheduler_sort(swapk_scheduler_t *sch);
 
@@ -247,16 +630,129 @@ void swapk_proc_init(swapk_scheduler_t *sch, swapk_proc_t *proc,
 		     swapk_stack_t *stack, swapk_entry entry,
 		     int priority);
 
+/**
+ * @brief Most of @p stack ever used, in bytes
+ *
+ * Counts from the base up to the first byte that no longer holds
+ * SWAPK_STACK_PAINT, so it is only accurate for stacks painted by
+ * swapkernel at init.
+ */
+unsigned int swapk_stack_used(const swapk_stack_t *stack);
+
+/** @brief Most of the system stack ever used, in bytes */
+unsigned int swapk_system_stack_used(swapk_scheduler_t *sch);
+
+/** @brief Most of core @p cid's idle stack ever used, in bytes */
+unsigned int swapk_sleep_stack_used(swapk_scheduler_t *sch,
+				    SWAPK_CORE_ID_T cid);
+
+#if SWAPK_PROC_HISTOGRAMS > 0
+/**
+ * @brief Copy a process's histograms
+ *
+ * Either of @p latency or @p run may be NULL. Each takes
+ * SWAPK_PROC_HIST_BUCKETS counts.
+ */
+void swapk_proc_hist_read(const swapk_proc_t *proc, uint32_t *latency,
+			  uint32_t *run);
+
+/** @brief Zero a process's histograms */
+void swapk_proc_hist_reset(swapk_proc_t *proc);
+
+/**
+ * @brief Bucket holding the @p pct percentile of a histogram
+ *
+ * @return Bucket index, or -1 if the histogram is empty
+ */
+int swapk_proc_hist_percentile(const uint32_t *hist, unsigned int pct);
+#endif /* #if SWAPK_PROC_HISTOGRAMS > 0 */
+
+/** @brief Same as swapk_proc_init(), but @p entry is passed @p arg */
+void swapk_proc_init_arg(swapk_scheduler_t *sch, swapk_proc_t *proc,
+			 swapk_stack_t *stack, swapk_entry entry,
+			 void *arg, int priority);
+
+/**
+ * @brief Start a process on a stack from the process pool
+ *
+ * The process is ready immediately. Its entry is passed @p arg
+ * rather than the scheduler. When it exits, by returning or with
+ * swapk_proc_exit(), its block goes back to the pool.
+ *
+ * @param stack_size Minimum stack the process needs
+ *
+ * @return The new process, or NULL if no block that big is free
+ */
+swapk_proc_t *swapk_proc_spawn(swapk_scheduler_t *sch, swapk_entry entry,
+			       void *arg, int priority,
+			       unsigned int stack_size);
+
+/**
+ * @brief End the calling process
+ *
+ * The process is never queued again and any processes in
+ * swapk_join() on it are woken with @p result. Pooled processes
+ * have their block recycled by the next scheduling pass.
+ */
+void swapk_proc_exit(swapk_scheduler_t *sch, void *result);
+
+/**
+ * @brief Block until a process exits and collect its result
+ *
+ * Joining after the process exited returns its result at once. A
+ * pooled block may be handed to a new process once it is recycled,
+ * so join pooled processes with swapk_join_pid() instead.
+ *
+ * @param result Set to the exited process's result on success. May
+ * be NULL
+ *
+ * @return true once @p proc has exited, false on timeout or if
+ * @p proc is the caller or was never started
+ */
+bool swapk_join(swapk_scheduler_t *sch, swapk_proc_t *proc,
+		SWAPK_ABSOLUTE_TIME_T time, void **result);
+
+/**
+ * @brief swapk_join() for a pooled process, by the PID it was
+ * spawned with
+ *
+ * @return As swapk_join(), and also false once the block has been
+ * recycled, as the result went with it
+ */
+bool swapk_join_pid(swapk_scheduler_t *sch, swapk_pid_t pid,
+		    SWAPK_ABSOLUTE_TIME_T time, void **result);
+
 swapk_proc_t *swapk_pop_proc(swapk_scheduler_t *sch);
 
 swapk_proc_t *swapk_push_proc(swapk_scheduler_t *sch,
 			      swapk_proc_t *proc);
 
+/**
+ * @brief Mark a process ready and ask the right core to run it
+ *
+ * An idle core the process may run on is preferred. Failing that,
+ * the core running the lowest priority preemptable process the
+ * woken process outranks is told to reschedule. If neither exists
+ * no core is disturbed and the process waits for the next
+ * scheduling pass.
+ *
+ * @return proc, or NULL if it was already ready
+ */
 swapk_proc_t *swapk_ready_proc(swapk_scheduler_t *sch,
 			       swapk_proc_t *proc);
 
 swapk_pid_t swapk_proc_get_pid(swapk_scheduler_t *sch);
 
+/**
+ * @brief Restrict the cores a process may run on
+ *
+ * @param mask Cores allowed, built from SWAPK_CORE_MASK()
+ * @param preferred Core to favour when several are allowed, or
+ * SWAPK_CORE_NONE to favour the core it last ran on
+ */
+void swapk_proc_set_affinity(swapk_proc_t *proc, SWAPK_CORE_MASK_T mask,
+			     int preferred);
+
 swapk_proc_t *swapk_proc_get(swapk_scheduler_t *sch);
 
 /**
@@ -282,6 +778,135 @@ void swapk_notify(swapk_scheduler_t *sch, swapk_proc_t *wake_up_proc);
 
 void swapk_notify_pid(swapk_scheduler_t *sch, swapk_pid_t pid);
 
+/**
+ * @brief Wake several processes at once
+ *
+ * Readies them all in one pass over the queue lock, then kicks each
+ * core that was handed one once and preempts the caller at most
+ * once. NULL entries are skipped.
+ */
+void swapk_notify_many(swapk_scheduler_t *sch, swapk_proc_t **procs,
+		       size_t n);
+
+/**
+ * @brief Wake a process from an interrupt handler
+ *
+ * Only records the wake on this core and asks for one scheduling
+ * pass, never waiting on the scheduler. Any number of wakes raised
+ * before that pass are handled by it together.
+ */
+void swapk_notify_from_isr(swapk_scheduler_t *sch, swapk_proc_t *proc);
+
+/**
+ * @brief Wake a process whose wait timed out, from an interrupt
+ *
+ * @param gen wait_gen of @p proc when its alarm was set. The wake is
+ * dropped if that wait has already ended
+ */
+void swapk_notify_timeout_from_isr(swapk_scheduler_t *sch,
+				   swapk_proc_t *proc, uint32_t gen);
+
+/** @brief Mask interrupts on this core, returning the old state */
+uint32_t swapk_irq_save(void);
+
+/** @brief Restore the state returned by swapk_irq_save() */
+void swapk_irq_restore(uint32_t save);
+
+/** @brief swapk_irq_save() that is never traced */
+uint32_t swapk_irq_save_untraced(void);
+
+/** @brief swapk_irq_restore() that is never traced */
+void swapk_irq_restore_untraced(uint32_t save);
+
+#if SWAPK_IRQ_TRACE > 0
+/** @brief Longest interrupts-masked window seen on a core */
+typedef struct {
+	/** Length of the window, in get_ticks units */
+	uint32_t max_ticks;
+
+	/** Return address near where that window was opened */
+	void *max_site;
+
+	/** Windows timed */
+	uint32_t windows;
+} swapk_irq_trace_t;
+
+/**
+ * @brief Open a window just after masking interrupts
+ *
+ * For port code that masks without swapk_irq_save(), such as a
+ * hardware spinlock. @p save is the state from before masking, so
+ * nested windows are ignored.
+ */
+void swapk_irq_trace_begin(uint32_t save, void *site);
+
+/** @brief Close the window opened with the same @p save, while still masked */
+void swapk_irq_trace_end(uint32_t save);
+
+/**
+ * @brief Copy the trace of core @p cid
+ *
+ * Not synchronised with that core, so read it from the core itself
+ * if max_ticks and max_site must match.
+ */
+void swapk_irq_trace_read(SWAPK_CORE_ID_T cid, swapk_irq_trace_t *out);
+
+/** @brief Zero the trace of core @p cid */
+void swapk_irq_trace_reset(SWAPK_CORE_ID_T cid);
+#endif /* #if SWAPK_IRQ_TRACE > 0 */
+
+void swapk_waitlist_init(swapk_waitlist_t *wl);
+
+/**
+ * @brief Snapshot a wait list before checking a wait condition
+ *
+ * Pass the result to swapk_waitlist_wait() after the condition was
+ * found false. A notify in between makes the wait return at once,
+ * so the wakeup can't be lost.
+ */
+uint32_t swapk_waitlist_prepare(swapk_waitlist_t *wl);
+
+/**
+ * @brief Block the calling process on a wait list
+ *
+ * @param seq Value from swapk_waitlist_prepare()
+ *
+ * @return true if woken by a notify (or one happened since @p seq),
+ * false on timeout
+ */
+bool swapk_waitlist_wait(swapk_scheduler_t *sch, swapk_waitlist_t *wl,
+			 uint32_t seq, SWAPK_ABSOLUTE_TIME_T time);
+
+/** @brief Wake every process blocked on a wait list */
+void swapk_waitlist_notify_all(swapk_scheduler_t *sch,
+			       swapk_waitlist_t *wl);
+
+/**
+ * @brief Block while a word still holds an expected value
+ *
+ * The check and the block happen under the queue lock, so a
+ * swapk_futex_wake() after the caller changed @p addr can't be
+ * missed.
+ *
+ * @return true if woken or @p addr no longer held @p expected, false
+ * on timeout
+ */
+bool swapk_futex_wait(swapk_scheduler_t *sch, volatile uint32_t *addr,
+		      uint32_t expected, SWAPK_ABSOLUTE_TIME_T time);
+
+/**
+ * @brief Wake up to @p n processes blocked on @p addr
+ *
+ * @return Number of processes woken
+ */
+int swapk_futex_wake(swapk_scheduler_t *sch, volatile uint32_t *addr,
+		     int n);
+
+/** @brief swapk_futex_wake() that never waits on the scheduler, for
+ * interrupt handlers */
+int swapk_futex_wake_from_isr(swapk_scheduler_t *sch,
+			      volatile uint32_t *addr, int n);
+
 /**
  * @}
  */ /* @defgroup swapk_wait_notify Wait/Notify System */
@@ -309,4 +934,8 @@ void swapk_event_clear_all(swapk_event_t *event);
  * @}
  */ /* @defgroup swapk_api */
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* #ifndef SWAPK_H */
@@ -0,0 +1,664 @@
+/**
+ * @file swapk_coro.hpp
+ * @author Tyler J. Anderson
+ * @brief C++20 coroutine executor running on a single swapk process
+ *
+ * Lets one swapk process run many small state machines, each with a
+ * heap allocated coroutine frame instead of its own stack.
+ *
+ * @code
+ * static swapk::executor ex(sch, now_us, to_abs_time);
+ * static swapk::event ready(ex);
+ *
+ * swapk::task<> blink()
+ * {
+ *	co_await ready;
+ *
+ *	for (;;) {
+ *		toggle_led();
+ *		co_await ex.sleep_for(500000);
+ *	}
+ * }
+ *
+ * void *coro_entry(void *arg)
+ * {
+ *	ex.spawn(blink());
+ *	ex.run();
+ *	return arg;
+ * }
+ * @endcode
+ */
+
+#ifndef SWAPK_CORO_HPP
+#define SWAPK_CORO_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "swapk.h"
+
+/**
+ * @defgroup swapk_coro Swapkernel Coroutine API
+ * @{
+ */
+
+namespace swapk {
+
+class executor;
+
+namespace detail {
+
+/* Intrusive list node for a suspended coroutine. Nodes live in the
+ * awaiter, and so in the frame of the coroutine that is waiting */
+struct waiter {
+	waiter *next = nullptr;
+	std::coroutine_handle<> handle;
+};
+
+struct timer : waiter {
+	uint64_t deadline = 0;
+};
+
+struct waiter_list {
+	waiter *head = nullptr;
+	waiter *tail = nullptr;
+
+	bool empty() const noexcept { return !head; }
+
+	void push(waiter *w) noexcept
+	{
+		w->next = nullptr;
+
+		if (tail)
+			tail->next = w;
+		else
+			head = w;
+
+		tail = w;
+	}
+
+	waiter *pop() noexcept
+	{
+		waiter *w = head;
+
+		if (w && !(head = w->next))
+			tail = nullptr;
+
+		return w;
+	}
+
+	void splice(waiter_list &other) noexcept
+	{
+		if (other.empty())
+			return;
+
+		if (tail)
+			tail->next = other.head;
+		else
+			head = other.head;
+
+		tail = other.tail;
+		other.head = other.tail = nullptr;
+	}
+};
+
+/* Something other processes can signal. The executor calls fire
+ * from its own process once it sees pending set */
+struct source {
+	source *next = nullptr;
+	volatile bool pending = false;
+	void (*fire)(source *) = nullptr;
+};
+
+struct promise_common {
+	/* Awaiting coroutine, resumed when this one finishes */
+	std::coroutine_handle<> continuation;
+
+	/* Set for tasks started with executor::spawn() */
+	executor *owner = nullptr;
+	waiter node;
+
+	struct final_awaiter {
+		bool await_ready() noexcept { return false; }
+
+		template <typename P>
+		std::coroutine_handle<>
+		await_suspend(std::coroutine_handle<P> h) noexcept;
+
+		void await_resume() noexcept {}
+	};
+
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	final_awaiter final_suspend() noexcept { return {}; }
+	void unhandled_exception() noexcept { std::terminate(); }
+
+	/* Never throw, a failed allocation gives an empty task */
+	static void *operator new(std::size_t n) noexcept
+	{
+		return ::operator new(n, std::nothrow);
+	}
+
+	static void operator delete(void *p) noexcept
+	{
+		::operator delete(p);
+	}
+};
+
+template <typename T>
+struct promise_value : promise_common {
+	T value{};
+
+	void return_value(T v) noexcept { value = std::move(v); }
+	T result() noexcept { return std::move(value); }
+};
+
+template <>
+struct promise_value<void> : promise_common {
+	void return_void() noexcept {}
+	void result() noexcept {}
+};
+
+} /* namespace detail */
+
+/**
+ * @brief A lazily started coroutine
+ *
+ * Runs when awaited by another task or handed to executor::spawn().
+ */
+template <typename T = void>
+class task {
+public:
+	struct promise_type : detail::promise_value<T> {
+		task get_return_object() noexcept
+		{
+			return task(handle::from_promise(*this));
+		}
+
+		static task get_return_object_on_allocation_failure() noexcept
+		{
+			return task();
+		}
+	};
+
+	using handle = std::coroutine_handle<promise_type>;
+
+	task() noexcept = default;
+	task(task &&other) noexcept : h_(std::exchange(other.h_, {})) {}
+	task(const task &) = delete;
+
+	task &operator=(task &&other) noexcept
+	{
+		if (this != &other) {
+			if (h_)
+				h_.destroy();
+
+			h_ = std::exchange(other.h_, {});
+		}
+
+		return *this;
+	}
+
+	~task()
+	{
+		if (h_)
+			h_.destroy();
+	}
+
+	/** @brief false if the frame could not be allocated */
+	explicit operator bool() const noexcept { return (bool) h_; }
+
+	auto operator co_await() && noexcept
+	{
+		struct awaiter {
+			handle h;
+
+			bool await_ready() noexcept { return !h || h.done(); }
+
+			std::coroutine_handle<>
+			await_suspend(std::coroutine_handle<> c) noexcept
+			{
+				h.promise().continuation = c;
+				return h;
+			}
+
+			T await_resume() noexcept
+			{
+				if constexpr (std::is_void_v<T>)
+					return;
+				else
+					return h ? h.promise().result() : T{};
+			}
+		};
+
+		return awaiter{h_};
+	}
+
+	handle release() noexcept { return std::exchange(h_, {}); }
+
+private:
+	explicit task(handle h) noexcept : h_(h) {}
+
+	handle h_;
+};
+
+/**
+ * @brief Runs coroutines on the swapk process that calls run()
+ *
+ * Time is in whatever unit @p now returns, typically microseconds.
+ * @p to_abs converts a deadline in that unit for swapk timed waits.
+ *
+ * Unless noted, members may only be used from the executor's own
+ * process, or before run() is called.
+ */
+class executor {
+public:
+	using now_fn = uint64_t (*)();
+	using abs_fn = SWAPK_ABSOLUTE_TIME_T (*)(uint64_t);
+
+	executor(swapk_scheduler_t *sch, now_fn now, abs_fn to_abs) noexcept
+		: sch_(sch), now_(now), to_abs_(to_abs)
+	{
+		swapk_waitlist_init(&wake_);
+	}
+
+	executor(const executor &) = delete;
+
+	swapk_scheduler_t *scheduler() const noexcept { return sch_; }
+	uint64_t now() const noexcept { return now_(); }
+
+	/** @brief Queue a task to run. false if it failed to allocate */
+	bool spawn(task<> &&t) noexcept
+	{
+		task<>::handle h = t.release();
+
+		if (!h)
+			return false;
+
+		h.promise().owner = this;
+		h.promise().node.handle = h;
+		++live_;
+		ready_.push(&h.promise().node);
+
+		return true;
+	}
+
+	/**
+	 * @brief Run coroutines until every spawned task has finished
+	 *
+	 * The calling process sleeps in a swapk timed wait whenever
+	 * nothing is ready.
+	 */
+	void run() noexcept
+	{
+		proc_ = swapk_proc_get(sch_);
+
+		while (live_) {
+			poll();
+
+			if (detail::waiter *w = ready_.pop()) {
+				w->handle.resume();
+				continue;
+			}
+
+			uint32_t seq = swapk_waitlist_prepare(&wake_);
+
+			SWAPK_MEMORY_BARRIER();
+
+			if (pending_ || expired())
+				continue;
+
+			swapk_waitlist_wait(sch_, &wake_, seq,
+					    timers_
+					    ? to_abs_(deadline(timers_))
+					    : SWAPK_FOREVER);
+		}
+
+		proc_ = nullptr;
+	}
+
+	/** @brief Suspend the calling coroutine until @p when */
+	auto sleep_until(uint64_t when) noexcept
+	{
+		struct awaiter : detail::timer {
+			executor &ex;
+
+			awaiter(executor &e, uint64_t d) noexcept : ex(e)
+			{
+				deadline = d;
+			}
+
+			bool await_ready() noexcept
+			{
+				return deadline <= ex.now();
+			}
+
+			void await_suspend(std::coroutine_handle<> h) noexcept
+			{
+				handle = h;
+				ex.add_timer(this);
+			}
+
+			void await_resume() noexcept {}
+		};
+
+		return awaiter(*this, when);
+	}
+
+	auto sleep_for(uint64_t delay) noexcept
+	{
+		return sleep_until(now() + delay);
+	}
+
+	/** @brief Let every other ready coroutine run first */
+	auto yield() noexcept
+	{
+		struct awaiter : detail::waiter {
+			executor &ex;
+
+			explicit awaiter(executor &e) noexcept : ex(e) {}
+
+			bool await_ready() noexcept { return false; }
+
+			void await_suspend(std::coroutine_handle<> h) noexcept
+			{
+				handle = h;
+				ex.schedule(this);
+			}
+
+			void await_resume() noexcept {}
+		};
+
+		return awaiter(*this);
+	}
+
+private:
+	friend struct detail::promise_common;
+	friend class event;
+	template <typename T, std::size_t N> friend class queue;
+
+	void schedule(detail::waiter *w) noexcept { ready_.push(w); }
+	void schedule(detail::waiter_list &l) noexcept { ready_.splice(l); }
+
+	void attach(detail::source *s) noexcept
+	{
+		s->next = sources_;
+		sources_ = s;
+	}
+
+	/* Safe from any process */
+	void signal(detail::source *s) noexcept
+	{
+		if (proc_ && swapk_proc_get(sch_) == proc_) {
+			s->fire(s);
+			return;
+		}
+
+		s->pending = true;
+		SWAPK_MEMORY_BARRIER();
+		pending_ = true;
+		swapk_waitlist_notify_all(sch_, &wake_);
+	}
+
+	static uint64_t deadline(detail::waiter *w) noexcept
+	{
+		return static_cast<detail::timer *>(w)->deadline;
+	}
+
+	/* Timers are kept sorted, soonest first */
+	void add_timer(detail::timer *t) noexcept
+	{
+		detail::waiter **pos = &timers_;
+
+		while (*pos && deadline(*pos) <= t->deadline)
+			pos = &(*pos)->next;
+
+		t->next = *pos;
+		*pos = t;
+	}
+
+	bool expired() noexcept
+	{
+		return timers_ && deadline(timers_) <= now();
+	}
+
+	void poll() noexcept
+	{
+		if (pending_) {
+			pending_ = false;
+			SWAPK_MEMORY_BARRIER();
+
+			for (detail::source *s = sources_; s; s = s->next) {
+				if (s->pending) {
+					s->pending = false;
+					s->fire(s);
+				}
+			}
+		}
+
+		if (timers_) {
+			uint64_t t = now();
+
+			while (timers_ && deadline(timers_) <= t) {
+				detail::waiter *tm = timers_;
+
+				timers_ = tm->next;
+				ready_.push(tm);
+			}
+		}
+	}
+
+	void task_done() noexcept { --live_; }
+
+	swapk_scheduler_t *sch_;
+	now_fn now_;
+	abs_fn to_abs_;
+	swapk_proc_t *proc_ = nullptr;
+	detail::waiter_list ready_;
+	detail::waiter *timers_ = nullptr;
+	detail::source *sources_ = nullptr;
+	volatile bool pending_ = false;
+	swapk_waitlist_t wake_;
+	unsigned int live_ = 0;
+};
+
+/**
+ * @brief Latching event awaited by coroutines
+ *
+ * set() may be called from any swapk process.
+ */
+class event : private detail::source {
+public:
+	explicit event(executor &ex) noexcept : ex_(ex)
+	{
+		fire = &event::on_fire;
+		ex.attach(this);
+	}
+
+	event(const event &) = delete;
+
+	void set() noexcept { ex_.signal(this); }
+	void reset() noexcept { set_ = false; }
+	bool is_set() const noexcept { return set_; }
+
+	auto operator co_await() noexcept
+	{
+		struct awaiter : detail::waiter {
+			event &ev;
+
+			explicit awaiter(event &e) noexcept : ev(e) {}
+
+			bool await_ready() noexcept { return ev.set_; }
+
+			void await_suspend(std::coroutine_handle<> h) noexcept
+			{
+				handle = h;
+				ev.waiters_.push(this);
+			}
+
+			void await_resume() noexcept {}
+		};
+
+		return awaiter(*this);
+	}
+
+private:
+	static void on_fire(detail::source *s) noexcept
+	{
+		event *ev = static_cast<event *>(s);
+
+		ev->set_ = true;
+		ev->ex_.schedule(ev->waiters_);
+	}
+
+	executor &ex_;
+	detail::waiter_list waiters_;
+	bool set_ = false;
+};
+
+/**
+ * @brief Bounded queue feeding coroutines
+ *
+ * A single producer, which may be another swapk process, pushes with
+ * try_push(). Coroutines on the executor take items with
+ * co_await pop().
+ */
+template <typename T, std::size_t N>
+class queue : private detail::source {
+	static_assert(N && !(N & (N - 1)), "queue length must be a power of two");
+
+public:
+	explicit queue(executor &ex) noexcept : ex_(ex)
+	{
+		fire = &queue::on_fire;
+		ex.attach(this);
+	}
+
+	queue(const queue &) = delete;
+
+	/** @brief false if the queue is full */
+	bool try_push(const T &v) noexcept
+	{
+		uint32_t head = head_;
+
+		if (head - tail_ >= N)
+			return false;
+
+		items_[head & (N - 1)] = v;
+		SWAPK_MEMORY_BARRIER();
+		head_ = head + 1;
+
+		/* Pairs with the barrier in pop's await_suspend, so either
+		 * we see the waiter or it sees the item */
+		SWAPK_MEMORY_BARRIER();
+
+		if (waiting_)
+			ex_.signal(this);
+
+		return true;
+	}
+
+	bool try_pop(T &v) noexcept
+	{
+		uint32_t tail = tail_;
+
+		if (tail == head_)
+			return false;
+
+		SWAPK_MEMORY_BARRIER();
+		v = std::move(items_[tail & (N - 1)]);
+		SWAPK_MEMORY_BARRIER();
+		tail_ = tail + 1;
+
+		return true;
+	}
+
+	auto pop() noexcept
+	{
+		struct awaiter : detail::waiter {
+			queue &q;
+			T value{};
+
+			explicit awaiter(queue &qu) noexcept : q(qu) {}
+
+			bool await_ready() noexcept
+			{
+				return q.waiters_.empty() && q.try_pop(value);
+			}
+
+			void await_suspend(std::coroutine_handle<> h) noexcept
+			{
+				handle = h;
+				q.waiters_.push(this);
+				q.waiting_ = true;
+				SWAPK_MEMORY_BARRIER();
+				q.deliver();
+			}
+
+			T await_resume() noexcept { return std::move(value); }
+		};
+
+		return awaiter(*this);
+	}
+
+private:
+	/* Hand items to waiters in order and make them ready */
+	void deliver() noexcept
+	{
+		using awaiter_t = decltype(pop());
+
+		while (!waiters_.empty()) {
+			awaiter_t *w = static_cast<awaiter_t *>(waiters_.head);
+
+			if (!try_pop(w->value))
+				return;
+
+			waiters_.pop();
+			ex_.schedule(w);
+		}
+
+		waiting_ = false;
+	}
+
+	static void on_fire(detail::source *s) noexcept
+	{
+		static_cast<queue *>(s)->deliver();
+	}
+
+	executor &ex_;
+	T items_[N];
+	volatile uint32_t head_ = 0;
+	volatile uint32_t tail_ = 0;
+	volatile bool waiting_ = false;
+	detail::waiter_list waiters_;
+};
+
+template <typename P>
+std::coroutine_handle<>
+detail::promise_common::final_awaiter::await_suspend(
+	std::coroutine_handle<P> h) noexcept
+{
+	promise_common &p = h.promise();
+
+	if (p.continuation)
+		return p.continuation;
+
+	if (executor *ex = p.owner) {
+		h.destroy();
+		ex->task_done();
+	}
+
+	return std::noop_coroutine();
+}
+
+} /* namespace swapk */
+
+/**
+ * @}
+ */ /* @defgroup swapk_coro */
+
+#endif /* #ifndef SWAPK_CORO_HPP */
@@ -0,0 +1,113 @@
+/**
+ * @file swapk_jobs.h
+ * @author Tyler J. Anderson
+ * @brief Job queue and parallel-for on top of swapkernel processes
+ */
+
+#ifndef SWAPK_JOBS_H
+#define SWAPK_JOBS_H
+
+#include "swapk.h"
+
+/**
+ * @defgroup swapk_jobs Swapkernel Job API
+ * @{
+ */
+
+#ifndef SWAPK_JOBS_QUEUE_LENGTH
+/** @brief Jobs each worker can hold. Must be a power of two */
+#define SWAPK_JOBS_QUEUE_LENGTH 16
+#endif
+
+#ifndef SWAPK_JOBS_MAX_WORKERS
+#define SWAPK_JOBS_MAX_WORKERS (2 * SWAPK_HARDWARE_THREADS)
+#endif
+
+/** @brief Run a job over the range [@p begin, @p end) */
+typedef void (*swapk_job_fn)(void *arg, int begin, int end);
+
+typedef struct {
+	swapk_job_fn fn;
+	void *arg;
+	int begin;
+	int end;
+} swapk_job_t;
+
+typedef struct {
+	swapk_proc_t proc;
+
+	/* Single producer, single consumer ring. Only the submitter
+	 * writes head and only the worker writes tail and completed */
+	swapk_job_t _queue[SWAPK_JOBS_QUEUE_LENGTH];
+	volatile uint32_t _head;
+	volatile uint32_t _tail;
+	volatile uint32_t _completed;
+
+	/** Worker sleeps here while its queue is empty */
+	swapk_waitlist_t _idle;
+	struct swapk_jobs *_jobs;
+} swapk_jobs_worker_t;
+
+/**
+ * @brief A pool of worker processes
+ *
+ * Jobs are spread round robin over the worker queues. Workers never
+ * take from each other's queues, as the Cortex-M0 has no
+ * compare-and-swap to make stealing safe without a lock.
+ *
+ * @note Only one process at a time may submit to a pool
+ */
+typedef struct swapk_jobs {
+	swapk_scheduler_t *sch;
+	swapk_jobs_worker_t workers[SWAPK_JOBS_MAX_WORKERS];
+	int worker_cnt;
+
+	/** Jobs handed to workers, not counting those run inline */
+	uint32_t submitted;
+
+	/** Submitter sleeps here in swapk_jobs_wait() */
+	swapk_waitlist_t _done;
+	int _next;
+} swapk_jobs_t;
+
+void swapk_jobs_init(swapk_jobs_t *jobs, swapk_scheduler_t *sch);
+
+/**
+ * @brief Start a worker process pinned to core @p cid
+ *
+ * @param priority Must be 0 or more, workers are preemptable
+ *
+ * @return Index of the worker, or -1 if the pool is full
+ */
+int swapk_jobs_add_worker(swapk_jobs_t *jobs, swapk_stack_t *stack,
+			  int priority, SWAPK_CORE_ID_T cid);
+
+/**
+ * @brief Queue a job on the next worker
+ *
+ * If every worker queue is full the job is run by the caller
+ * before returning.
+ */
+void swapk_jobs_submit(swapk_jobs_t *jobs, swapk_job_fn fn, void *arg,
+		       int begin, int end);
+
+/** @brief Jobs submitted to workers and not yet completed */
+uint32_t swapk_jobs_pending(swapk_jobs_t *jobs);
+
+/** @brief Block the calling process until every submitted job is done */
+void swapk_jobs_wait(swapk_jobs_t *jobs);
+
+/**
+ * @brief Split [@p begin, @p end) into chunks of @p grain and run
+ * them on the pool
+ *
+ * Returns once every chunk has completed.
+ */
+void swapk_parallel_for(swapk_jobs_t *jobs, int begin, int end, int grain,
+			swapk_job_fn fn, void *arg);
+
+/**
+ * @}
+ */ /* @defgroup swapk_jobs */
+
+#endif /* #ifndef SWAPK_JOBS_H */
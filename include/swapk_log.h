@@ -0,0 +1,160 @@
+/**
+ * @file swapk_log.h
+ * @author Tyler J. Anderson
+ * @brief Deferred-format binary logging for swapkernel
+ */
+
+#ifndef SWAPK_LOG_H
+#define SWAPK_LOG_H
+
+#include "swapk.h"
+
+#include <stddef.h>
+
+/**
+ * @defgroup swapk_log Swapkernel Log API
+ *
+ * SWAPK_LOG() stores the format pointer, a timestamp, the PID and up
+ * to SWAPK_LOG_MAX_ARGS raw argument words in a ring for the calling
+ * core. Nothing is formatted until a reader does it later, either
+ * with swapk_log_format() on target or with
+ * tools/swapk-log-decode.py against the ELF.
+ *
+ * Arguments are stored as 32 bit words, so only integers, chars and
+ * pointers can be logged. A %s argument must point to a string that
+ * is still there when the record is decoded, such as a literal.
+ * @{
+ */
+
+#define SWAPK_LOG_LEVEL_NONE 0
+#define SWAPK_LOG_LEVEL_ERROR 1
+#define SWAPK_LOG_LEVEL_WARN 2
+#define SWAPK_LOG_LEVEL_INFO 3
+#define SWAPK_LOG_LEVEL_DEBUG 4
+
+#ifndef SWAPK_LOG_LEVEL
+/** @brief Most verbose level compiled in. Calls above it vanish */
+#define SWAPK_LOG_LEVEL SWAPK_LOG_LEVEL_INFO
+#endif
+
+#ifndef SWAPK_LOG_RING_WORDS
+/** @brief Words of log each core can hold, a power of two */
+#define SWAPK_LOG_RING_WORDS 256
+#endif
+
+/**
+ * @brief Most arguments one record can carry
+ *
+ * Fixed by the _SWAPK_LOG_CALL_ macros below, so it can't be
+ * raised by defining it.
+ */
+#define SWAPK_LOG_MAX_ARGS 4
+
+/* Header word: nargs, level, core and a sync nibble, then PID */
+#define SWAPK_LOG_HDR_SYNC 0xa
+#define SWAPK_LOG_HDR(level, nargs)					\
+	((uint32_t) (nargs) | ((uint32_t) (level) << 4) |		\
+	 ((uint32_t) SWAPK_LOG_HDR_SYNC << 12))
+
+/* Header, timestamp and format pointer come before the args */
+#define SWAPK_LOG_RECORD_WORDS(hdr) (3 + ((hdr) & 0xf))
+
+/* Counts to 12 so that 5 to 12 arguments hit _SWAPK_LOG_CALL_MAX
+ * and fail with a message, rather than an unrelated macro error */
+#define _SWAPK_LOG_NARGS(...)						\
+	_SWAPK_LOG_NARGS_(_, ##__VA_ARGS__, MAX, MAX, MAX, MAX, MAX,	\
+			  MAX, MAX, MAX, 4, 3, 2, 1, 0)
+#define _SWAPK_LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9,	\
+			  _10, _11, _12, n, ...) n
+
+#define _SWAPK_LOG_CAT(a, b) _SWAPK_LOG_CAT_(a, b)
+#define _SWAPK_LOG_CAT_(a, b) a ## b
+
+#define _SWAPK_LOG_CALL_0(level, fmt)					\
+	swapk_log_record(SWAPK_LOG_HDR(level, 0), fmt, NULL)
+#define _SWAPK_LOG_CALL_1(level, fmt, a)				\
+	swapk_log_record(SWAPK_LOG_HDR(level, 1), fmt,			\
+			 (const uint32_t[]) {(uint32_t) (a)})
+#define _SWAPK_LOG_CALL_2(level, fmt, a, b)				\
+	swapk_log_record(SWAPK_LOG_HDR(level, 2), fmt,			\
+			 (const uint32_t[]) {(uint32_t) (a),		\
+					     (uint32_t) (b)})
+#define _SWAPK_LOG_CALL_3(level, fmt, a, b, c)				\
+	swapk_log_record(SWAPK_LOG_HDR(level, 3), fmt,			\
+			 (const uint32_t[]) {(uint32_t) (a),		\
+					     (uint32_t) (b),		\
+					     (uint32_t) (c)})
+#define _SWAPK_LOG_CALL_4(level, fmt, a, b, c, d)			\
+	swapk_log_record(SWAPK_LOG_HDR(level, 4), fmt,			\
+			 (const uint32_t[]) {(uint32_t) (a),		\
+					     (uint32_t) (b),		\
+					     (uint32_t) (c),		\
+					     (uint32_t) (d)})
+#define _SWAPK_LOG_CALL_MAX(level, fmt, ...)				\
+	((void) sizeof(struct {						\
+		_Static_assert(0, "SWAPK_LOG() takes at most "		\
+			       "SWAPK_LOG_MAX_ARGS (4) arguments");	\
+		int unused;						\
+	}))
+
+/**
+ * @brief Log at @p level if it is compiled in
+ *
+ * Takes at most SWAPK_LOG_MAX_ARGS arguments after @p fmt. More is
+ * a compile error.
+ */
+#define SWAPK_LOG_AT(level, fmt, ...)					\
+	do {								\
+		if ((level) <= SWAPK_LOG_LEVEL)				\
+			_SWAPK_LOG_CAT(_SWAPK_LOG_CALL_,		\
+				       _SWAPK_LOG_NARGS(__VA_ARGS__))	\
+				(level, fmt, ##__VA_ARGS__);		\
+	} while (0)
+
+#define SWAPK_LOG_ERROR(fmt, ...)					\
+	SWAPK_LOG_AT(SWAPK_LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define SWAPK_LOG_WARN(fmt, ...)					\
+	SWAPK_LOG_AT(SWAPK_LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define SWAPK_LOG_INFO(fmt, ...)					\
+	SWAPK_LOG_AT(SWAPK_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define SWAPK_LOG_DEBUG(fmt, ...)					\
+	SWAPK_LOG_AT(SWAPK_LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+/** @brief Log at info level */
+#define SWAPK_LOG(fmt, ...) SWAPK_LOG_INFO(fmt, ##__VA_ARGS__)
+
+/** @brief Point the log at the scheduler it takes PIDs and ticks from */
+void swapk_log_init(swapk_scheduler_t *sch);
+
+/**
+ * @brief Append a record to the calling core's ring
+ *
+ * Use SWAPK_LOG() instead. Safe from interrupts. A record that
+ * doesn't fit is dropped and counted.
+ */
+void swapk_log_record(uint32_t hdr, const char *fmt, const uint32_t *args);
+
+/**
+ * @brief Move whole records out of a core's ring
+ *
+ * Only one reader per core at a time.
+ *
+ * @return Words copied to @p out
+ */
+size_t swapk_log_read(SWAPK_CORE_ID_T cid, uint32_t *out, size_t max);
+
+/**
+ * @brief Format one record read by swapk_log_read()
+ *
+ * @return As snprintf()
+ */
+int swapk_log_format(const uint32_t *rec, char *buf, size_t len);
+
+/** @brief Records dropped on @p cid because its ring was full */
+uint32_t swapk_log_dropped(SWAPK_CORE_ID_T cid);
+
+/**
+ * @}
+ */ /* @defgroup swapk_log */
+
+#endif /* #ifndef SWAPK_LOG_H */
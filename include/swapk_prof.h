@@ -0,0 +1,75 @@
+/**
+ * @file swapk_prof.h
+ * @author Tyler J. Anderson
+ * @brief Sampling profiler for swapkernel
+ */
+
+#ifndef SWAPK_PROF_H
+#define SWAPK_PROF_H
+
+#include "swapk.h"
+
+#include <stddef.h>
+
+/**
+ * @defgroup swapk_prof Swapkernel Profiler API
+ *
+ * swapk_prof_isr() is installed as the handler of a periodic timer
+ * exception. Each tick it takes the PC stacked by the interrupted
+ * code, from the PSP for processes or the MSP for handlers, and
+ * stores it with the PID in a ring for the calling core. The rings
+ * are read out with swapk_prof_read() and turned into per process
+ * flat profiles by tools/swapk-prof.py against the ELF.
+ * @{
+ */
+
+#ifndef SWAPK_PROF_RING_WORDS
+/** @brief Words of samples each core can hold, a power of two */
+#define SWAPK_PROF_RING_WORDS 512
+#endif
+
+/** @brief Words in one sample: header then PC */
+#define SWAPK_PROF_SAMPLE_WORDS 2
+
+/* Header word: handler flag, core and a sync nibble, then PID */
+#define SWAPK_PROF_HDR_SYNC 0xb
+#define SWAPK_PROF_HDR_HANDLER 0x1
+
+/** @brief Point the profiler at the scheduler it takes PIDs from */
+void swapk_prof_init(swapk_scheduler_t *sch);
+
+/**
+ * @brief Timer exception handler that takes one sample
+ *
+ * Must be entered straight from the exception, with the EXC_RETURN
+ * value still in lr, so install it in the vector table rather than
+ * calling it.
+ */
+void swapk_prof_isr(void);
+
+/**
+ * @brief Append a sample to the calling core's ring
+ *
+ * Called by swapk_prof_isr(). @p handler is true when the
+ * interrupted code was on the main stack, so no process owned it. A
+ * sample that doesn't fit is dropped and counted.
+ */
+void swapk_prof_record(uint32_t pc, bool handler);
+
+/**
+ * @brief Move whole samples out of a core's ring
+ *
+ * Only one reader per core at a time.
+ *
+ * @return Words copied to @p out
+ */
+size_t swapk_prof_read(SWAPK_CORE_ID_T cid, uint32_t *out, size_t max);
+
+/** @brief Samples dropped on @p cid because its ring was full */
+uint32_t swapk_prof_dropped(SWAPK_CORE_ID_T cid);
+
+/**
+ * @}
+ */ /* @defgroup swapk_prof Swapkernel Profiler API */
+
+#endif /* #ifndef SWAPK_PROF_H */
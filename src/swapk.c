@@ -9,6 +9,20 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if SWAPK_ISR_WAKE_SLOTS < 1 || SWAPK_ISR_WAKE_SLOTS > 128 || \
+	(SWAPK_ISR_WAKE_SLOTS & (SWAPK_ISR_WAKE_SLOTS - 1))
+#error "SWAPK_ISR_WAKE_SLOTS must be a power of two up to 128"
+#endif
+
+#if SWAPK_FUTEX_BUCKETS < 1 || \
+	(SWAPK_FUTEX_BUCKETS & (SWAPK_FUTEX_BUCKETS - 1))
+#error "SWAPK_FUTEX_BUCKETS must be a power of two"
+#endif
+
+#if SWAPK_CALL_ARGS_MAX < 3
+#error "SWAPK_CALL_ARGS_MAX must fit the scheduler's own calls (3)"
+#endif
+
 /*
 **********************************************************************
 *                                                                    *
@@ -23,11 +37,22 @@ extern void swapk_register_proc(void *entry, void *stack, void *end,
 				void *arg);
 extern void swapk_startup(void *systemsp, swapk_entry entry,
 			  swapk_scheduler_t *sch);
+#if SWAPK_COOPERATIVE_ONLY > 0
+extern void swapk_context_swap(void **current, void *next);
+#else
 extern void swapk_set_pending();
 extern void swapk_svc_enable();
 extern void swapk_svc_disable();
 extern void swapk_svc_pend();
 extern void swapk_pendsv_swap(void **current, void **next);
+#endif
+
+/* Called from kernel.S */
+void _swapk_switch_finish(void);
+#if SWAPK_IRQ_TRACE > 0 && SWAPK_COOPERATIVE_ONLY == 0
+void _swapk_irq_trace_swap_begin(void);
+void _swapk_irq_trace_swap_end(void);
+#endif
 
 /*
 **********************************************************************
@@ -37,10 +62,92 @@ extern void swapk_pendsv_swap(void **current, void **next);
 **********************************************************************
 */
 
+#if SWAPK_POOL_PROCS > 0
+static const unsigned int _swapk_pool_stack_size[SWAPK_POOL_CLASSES] = {
+	SWAPK_POOL_SMALL_STACK_SIZE,
+	SWAPK_POOL_LARGE_STACK_SIZE
+};
+#endif /* #if SWAPK_POOL_PROCS > 0 */
+
 struct timespec swapk_empty_time = {0};
 struct timespec swapk_full_time = {.tv_nsec = (long)-1, .tv_sec = (time_t)-1};
 static swapk_callbacks_t *_swapk_cbptr = NULL;
 
+#if SWAPK_IRQ_TRACE > 0
+/* Only touched by its own core with interrupts masked */
+static struct {
+	swapk_irq_trace_t trace;
+	uint32_t start;
+	void *site;
+	uint32_t opened;
+	bool open;
+} _swapk_irq_trace[SWAPK_HARDWARE_THREADS];
+
+static swapk_callbacks_t *_swapk_irq_trace_cb = NULL;
+#endif /* #if SWAPK_IRQ_TRACE > 0 */
+
+/* Constant on single core builds, so per-core indexing folds away */
+static inline SWAPK_CORE_ID_T _swapk_core_id(swapk_callbacks_t *cb)
+{
+#if SWAPK_HARDWARE_THREADS > 1
+	return cb->core_get_id();
+#else
+	(void) cb;
+	return 0;
+#endif
+}
+
+#if SWAPK_PROC_HISTOGRAMS > 0
+static inline int _swapk_hist_bucket(uint32_t ticks)
+{
+	int b = ticks ? 32 - __builtin_clz(ticks) : 0;
+
+	return b < SWAPK_PROC_HIST_BUCKETS ? b : SWAPK_PROC_HIST_BUCKETS - 1;
+}
+
+/* Called with the queue lock held as the process is readied */
+static inline void _swapk_hist_ready(swapk_callbacks_t *cb,
+				     swapk_proc_t *proc)
+{
+	if (!cb->get_ticks)
+		return;
+
+	proc->_ready_tick = cb->get_ticks();
+	proc->_ready_stamped = true;
+}
+
+/* Called on the switch path just before current leaves the core */
+static inline void _swapk_hist_switch(swapk_callbacks_t *cb,
+				      swapk_proc_t *current,
+				      swapk_proc_t *next)
+{
+	uint32_t now;
+
+	if (!cb->get_ticks)
+		return;
+
+	now = cb->get_ticks();
+
+	if (current->_run_stamped)
+		++current->hist_run[_swapk_hist_bucket(now -
+						       current->_run_tick)];
+
+	/* A stamp left from before current was switched out would
+	 * count its time queued behind others as wake latency */
+	current->_run_stamped = false;
+	current->_ready_stamped = false;
+
+	if (next->_ready_stamped) {
+		++next->hist_latency[_swapk_hist_bucket(now -
+							next->_ready_tick)];
+		next->_ready_stamped = false;
+	}
+
+	next->_run_tick = now;
+	next->_run_stamped = true;
+}
+#endif /* #if SWAPK_PROC_HISTOGRAMS > 0 */
+
 static int _swapk_proc_compare(swapk_scheduler_t *sch, swapk_proc_t *proca,
 			       swapk_proc_t *procb);
 
@@ -54,6 +161,17 @@ static void *_swapk_core_launch(void*);
 
 static void _swapk_end_proc(void*);
 
+static void _swapk_proc_setup(swapk_scheduler_t *sch, swapk_proc_t *proc,
+			      swapk_stack_t *stack, swapk_entry entry,
+			      void *arg, int priority);
+
+static void _swapk_reap_proc(swapk_scheduler_t *sch, swapk_proc_t *proc);
+
+static bool _swapk_join_locked(swapk_scheduler_t *sch, swapk_proc_t *proc,
+			       SWAPK_ABSOLUTE_TIME_T time, void **result);
+
+static void _swapk_pool_init(swapk_scheduler_t *sch);
+
 static void _swapk_proc_swap(swapk_scheduler_t *sch,
 			     swapk_proc_t *current,
 			     swapk_proc_t *next);
@@ -61,16 +179,28 @@ static void _swapk_proc_swap(swapk_scheduler_t *sch,
 static swapk_proc_t *_swapk_find_pid(swapk_scheduler_t *sch,
 				     swapk_pid_t pid);
 
+#if SWAPK_COOPERATIVE_ONLY == 0
 static void _swapk_svc_handler(swapk_scheduler_t *sch);
+#endif
 
+#if SWAPK_COOPERATIVE_ONLY == 0 && SWAPK_HARDWARE_THREADS > 1
 static void _swapk_call_common(swapk_scheduler_t *sch,
 			       swapk_system_call call);
+#endif
 
+#if SWAPK_HARDWARE_THREADS > 1
 static int _swapk_call_scheduler_available(int argc, void **argv);
+#endif
+
+#if SWAPK_COOPERATIVE_ONLY > 0 && SWAPK_HARDWARE_THREADS > 1
+static int _swapk_scheduler_available(void *arg);
+#endif
 
 static bool _swapk_maybe_switch_context(swapk_scheduler_t *sch);
 
+#if SWAPK_HARDWARE_THREADS > 1
 static void _swapk_wait_for_scheduler(swapk_scheduler_t *sch);
+#endif
 
 static bool _swapk_is_swapk_forever(SWAPK_ABSOLUTE_TIME_T time);
 
@@ -83,6 +213,71 @@ static void _swapk_insert_sorted_forward(swapk_scheduler_t *sch,
 static bool _swapk_check_core_affinity(swapk_scheduler_t *sch,
 				       swapk_proc_t *proc);
 
+static bool _swapk_prefers_core(swapk_proc_t *proc, SWAPK_CORE_ID_T cid);
+
+static bool _swapk_still_best(swapk_scheduler_t *sch,
+			      swapk_proc_t *current);
+
+static void _swapk_yield(swapk_scheduler_t *sch, bool preempted);
+
+static SWAPK_CORE_MASK_T _swapk_drain_isr_wakes(swapk_scheduler_t *sch);
+
+static swapk_proc_t *_swapk_queue_select(swapk_scheduler_t *sch);
+
+static void _swapk_lock_queue(swapk_scheduler_t *sch);
+
+static void _swapk_unlock_queue(swapk_scheduler_t *sch);
+
+static swapk_proc_t *_swapk_queue_pop(swapk_scheduler_t *sch);
+
+static void _swapk_kick_core(swapk_scheduler_t *sch, SWAPK_CORE_ID_T cid);
+
+#if SWAPK_HARDWARE_THREADS > 1
+static void _swapk_kick_others(swapk_scheduler_t *sch, SWAPK_CORE_ID_T cid);
+#endif
+
+static void _swapk_kick_mask(swapk_scheduler_t *sch, SWAPK_CORE_MASK_T mask);
+
+static void _swapk_kick_mask_from_isr(swapk_scheduler_t *sch,
+				      SWAPK_CORE_MASK_T mask);
+
+static swapk_waitlist_t *_swapk_futex_bucket(swapk_scheduler_t *sch,
+					     volatile uint32_t *addr);
+
+static SWAPK_CORE_MASK_T _swapk_futex_wake_locked(swapk_scheduler_t *sch,
+						  volatile uint32_t *addr,
+						  int n, int *woken);
+
+static swapk_proc_t *_swapk_ready_proc(swapk_scheduler_t *sch,
+				       swapk_proc_t *proc, int *placed);
+
+static int _swapk_find_idle_core(swapk_scheduler_t *sch,
+				 swapk_proc_t *proc);
+
+static bool _swapk_ready_locked(swapk_scheduler_t *sch,
+				swapk_proc_t *proc, int *placed);
+
+static void _swapk_requeue_locked(swapk_scheduler_t *sch,
+				  swapk_proc_t *proc);
+
+static void _swapk_preempt_for(swapk_scheduler_t *sch,
+			       swapk_proc_t *proc, int placed);
+
+static void _swapk_block(swapk_scheduler_t *sch, swapk_proc_t *proc,
+			 SWAPK_ABSOLUTE_TIME_T time);
+
+static bool _swapk_waitlist_block(swapk_scheduler_t *sch,
+				  swapk_waitlist_t *wl,
+				  SWAPK_ABSOLUTE_TIME_T time);
+
+static bool _swapk_is_core_idle(swapk_scheduler_t *sch,
+				swapk_proc_t *proc, int cid);
+
+static int _swapk_find_preempt_core(swapk_scheduler_t *sch,
+				    swapk_proc_t *proc);
+
+static void _swapk_queue_sort(swapk_scheduler_t *sch);
+
 /*
 **********************************************************************
 *                                                                    *
@@ -95,53 +290,220 @@ void swapk_proc_init(swapk_scheduler_t *sch, swapk_proc_t *proc,
 		     swapk_stack_t *stack, swapk_entry entry,
 		     int priority)
 {
-	proc->stack = stack;
-	proc->ready = true;
-	proc->priority = priority;
-	proc->pid = sch->proc_cnt++;
-	proc->entry = entry;
-	proc->core_affinity = 0;
-	proc->core_id = -1;
+	swapk_proc_init_arg(sch, proc, stack, entry, sch, priority);
+}
 
-	memset(proc->stack->stackbase, 0,
-	       proc->stack->stacksize);
+void swapk_proc_init_arg(swapk_scheduler_t *sch, swapk_proc_t *proc,
+			 swapk_stack_t *stack, swapk_entry entry,
+			 void *arg, int priority)
+{
+	proc->pool_class = SWAPK_POOL_NONE;
 
-	swapk_register_proc(proc->entry, &proc->stack->stackptr,
-			    _swapk_end_proc, sch);
-	swapk_push_proc(sch, proc);
+	memset(stack->stackbase, SWAPK_STACK_PAINT, stack->stacksize);
+
+	_swapk_proc_setup(sch, proc, stack, entry, arg, priority);
+}
+
+unsigned int swapk_stack_used(const swapk_stack_t *stack)
+{
+	const uint8_t *base = stack->stackbase;
+	unsigned int i = 0;
+
+	/* Stacks grow down, so the untouched bytes are at the base */
+	while (i < stack->stacksize && base[i] == SWAPK_STACK_PAINT)
+		++i;
+
+	return stack->stacksize - i;
+}
+
+#if SWAPK_PROC_HISTOGRAMS > 0
+void swapk_proc_hist_read(const swapk_proc_t *proc, uint32_t *latency,
+			  uint32_t *run)
+{
+	if (latency)
+		memcpy(latency, proc->hist_latency,
+		       sizeof(proc->hist_latency));
+
+	if (run)
+		memcpy(run, proc->hist_run, sizeof(proc->hist_run));
+}
+
+void swapk_proc_hist_reset(swapk_proc_t *proc)
+{
+	memset(proc->hist_latency, 0, sizeof(proc->hist_latency));
+	memset(proc->hist_run, 0, sizeof(proc->hist_run));
+}
+
+int swapk_proc_hist_percentile(const uint32_t *hist, unsigned int pct)
+{
+	uint64_t total = 0;
+	uint64_t seen = 0;
+
+	for (int b = 0; b < SWAPK_PROC_HIST_BUCKETS; ++b)
+		total += hist[b];
+
+	if (!total)
+		return -1;
+
+	for (int b = 0; b < SWAPK_PROC_HIST_BUCKETS; ++b) {
+		seen += hist[b];
+
+		if (seen * 100 >= total * pct)
+			return b;
+	}
+
+	return SWAPK_PROC_HIST_BUCKETS - 1;
+}
+#endif /* #if SWAPK_PROC_HISTOGRAMS > 0 */
+
+unsigned int swapk_system_stack_used(swapk_scheduler_t *sch)
+{
+	return swapk_stack_used(&sch->_system_stack);
+}
+
+unsigned int swapk_sleep_stack_used(swapk_scheduler_t *sch,
+				    SWAPK_CORE_ID_T cid)
+{
+	return swapk_stack_used(&sch->_sleep_stack[cid]);
+}
+
+swapk_proc_t *swapk_proc_spawn(swapk_scheduler_t *sch, swapk_entry entry,
+			       void *arg, int priority,
+			       unsigned int stack_size)
+{
+#if SWAPK_POOL_PROCS > 0
+	swapk_proc_t *proc = NULL;
+
+	_swapk_lock_queue(sch);
+
+	/* Smallest class that fits, falling back to bigger ones */
+	for (int i = 0; i < SWAPK_POOL_CLASSES && !proc; ++i) {
+		struct swapk_proc_queue *q = &sch->_pool_free[i];
+
+		if (stack_size > _swapk_pool_stack_size[i] || TAILQ_EMPTY(q))
+			continue;
+
+		proc = TAILQ_FIRST(q);
+		TAILQ_REMOVE(q, proc, _tailq_entry);
+	}
+
+	_swapk_unlock_queue(sch);
+
+	if (!proc)
+		return NULL;
+
+	/* Stacks aren't cleared so spawning stays constant time */
+	proc->stack->stackptr = (uint8_t*) proc->stack->stackbase
+		+ proc->stack->stacksize - 1;
+	_swapk_proc_setup(sch, proc, proc->stack, entry, arg, priority);
+
+	return proc;
+#else
+	(void) sch;
+	(void) entry;
+	(void) arg;
+	(void) priority;
+	(void) stack_size;
+
+	return NULL;
+#endif /* #if SWAPK_POOL_PROCS > 0 */
+}
+
+void swapk_proc_exit(swapk_scheduler_t *sch, void *result)
+{
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	swapk_proc_t *current = sch->current[cid];
+	swapk_proc_t *joiner;
+	SWAPK_CORE_MASK_T kick = 0;
+	int placed;
+
+	/* The system process can't exit */
+	if (!current)
+		return;
+
+	/* Exiting, waking the joiners and kicking their cores is one
+	 * step. Being preempted between them would leave joiners on
+	 * other cores readied but unkicked until we run again */
+	swapk_sched_lock(sch);
+	_swapk_lock_queue(sch);
+	current->exited = true;
+	current->ready = false;
+	current->result = result;
+
+	/* Hand the result to each joiner directly, as a pooled block
+	 * may be reused before they get to run */
+	while ((joiner = TAILQ_FIRST(&current->joiners.procs))) {
+		TAILQ_REMOVE(&current->joiners.procs, joiner, _wait_entry);
+		joiner->_waitlist = NULL;
+		joiner->_wait_data = result;
+
+		if (_swapk_ready_locked(sch, joiner, &placed) &&
+		    placed != SWAPK_CORE_NONE && placed != cid)
+			kick |= SWAPK_CORE_MASK(placed);
+	}
+
+	++current->joiners.seq;
+	_swapk_unlock_queue(sch);
+
+	_swapk_kick_mask(sch, kick);
+	swapk_sched_unlock(sch);
+
+	/* The scheduler won't queue us again, so this never
+	 * returns */
+	for (;;)
+		swapk_yield(sch);
 }
 
 void swapk_scheduler_init(swapk_scheduler_t *sch,
 			  swapk_callbacks_t *cb_list)
 {
 	sch->cb_list = cb_list;
+#if SWAPK_IRQ_TRACE > 0
+	_swapk_irq_trace_cb = cb_list;
+#endif
 	TAILQ_INIT(&sch->procqueue);
 	sch->proc_cnt = 0;
+#if SWAPK_HARDWARE_THREADS > 1
 	sch->cb_list->sem_sch_set_permits(1);
+#endif
 #if SWAPK_UNMANAGED_PROCS > 0
 	sch->unmanaged = NULL;
 	TAILQ_INIT(&sch->unmanaged_queue);
 #endif /* #if SWAPK_UNMANAGED_PROCS > 0 */
 
+	_swapk_pool_init(sch);
+
+	for (int i = 0; i < SWAPK_FUTEX_BUCKETS; ++i)
+		swapk_waitlist_init(&sch->_futex[i]);
+
 	for (SWAPK_CORE_ID_T i = 0; i < SWAPK_HARDWARE_THREADS; ++i) {
 		sch->context_shift[i] = true;
 		sch->current[i] = NULL;
+		memset(&sch->stats[i], 0, sizeof(sch->stats[i]));
 		sch->_current[i] = NULL;
 		sch->_next[i] = NULL;
 		sch->_last[i] = NULL;
+		sch->_isr_wake_head[i] = 0;
+		sch->_isr_wake_tail[i] = 0;
+		sch->_isr_wake_pending[i] = false;
 		swapk_event_init(&sch->events[i], 0);
 
 		/* Add the sleep processes */
 		swapk_stack_t *sstack = &sch->_sleep_stack[i];
 		sstack->stacksize = SWAPK_SLEEP_STACK_SIZE;
+#if SWAPK_EXTERNAL_SLEEP_STACKS > 0
+		sstack->stackbase = swapk_sleep_stack_data[i];
+#else
 		sstack->stackbase = sch->_sleep_stack_data[i];
-		sstack->stackptr
-			= &sch->_sleep_stack_data[i][SWAPK_SLEEP_STACK_SIZE - 1];
+#endif
+		sstack->stackptr = &((uint8_t*) sstack->stackbase)
+			[SWAPK_SLEEP_STACK_SIZE - 1];
 		swapk_proc_init(sch, &sch->_sleep_proc[i],
 				&sch->_sleep_stack[i],
 				_swapk_sleep_entry,
 				SWAPK_SLEEP_PROC_PRIORITY);
-		sch->_sleep_proc[i].core_affinity = -1 * i;
+		swapk_proc_set_affinity(&sch->_sleep_proc[i],
+					SWAPK_CORE_MASK(i), i);
 	}
 
 	/* Don't use library func to init system process, as we aren't
@@ -157,10 +519,28 @@ void swapk_scheduler_init(swapk_scheduler_t *sch,
 	sys->stack->stackbase = sch->_system_stack_data;
 	sys->stack->stackptr
 		= &sch->_system_stack_data[sys->stack->stacksize - 1];
-	sys->core_affinity = 0;
+	sys->core_mask = SWAPK_CORE_MASK_ANY;
+	sys->core_preferred = SWAPK_CORE_NONE;
 	sys->core_id = -1;
-
-	memset(sys->stack->stackbase, 0, sys->stack->stacksize);
+	sys->core_last = -1;
+	sys->migrations = 0;
+	sys->exited = false;
+	sys->pool_class = SWAPK_POOL_NONE;
+	sys->result = NULL;
+	sys->wait_gen = 0;
+	sys->_waitlist = NULL;
+	sys->sched_lock_depth = 0;
+	sys->_timed_out = false;
+	sys->_sched_deferred = false;
+#if SWAPK_PROC_HISTOGRAMS > 0
+	sys->_ready_stamped = false;
+	sys->_run_stamped = false;
+	swapk_proc_hist_reset(sys);
+#endif
+	swapk_waitlist_init(&sys->joiners);
+
+	memset(sys->stack->stackbase, SWAPK_STACK_PAINT,
+	       sys->stack->stacksize);
 }
 
 void swapk_scheduler_start(swapk_scheduler_t *sch)
@@ -174,23 +554,25 @@ void swapk_scheduler_start(swapk_scheduler_t *sch)
 		      sch->_system_proc.entry, sch);
 }
 
+SWAPK_HOT
 swapk_proc_t *swapk_pop_proc(swapk_scheduler_t *sch)
 {
 	swapk_proc_t *ret;
 
-	if (TAILQ_EMPTY(&sch->procqueue))
-		return NULL;
-
-	ret = TAILQ_FIRST(&sch->procqueue);
-	TAILQ_REMOVE(&sch->procqueue, ret, _tailq_entry);
+	_swapk_lock_queue(sch);
+	ret = _swapk_queue_pop(sch);
+	_swapk_unlock_queue(sch);
 
 	return ret;
 }
 
+SWAPK_HOT
 swapk_proc_t *swapk_push_proc(swapk_scheduler_t *sch,
 			      swapk_proc_t *proc)
 {
+	_swapk_lock_queue(sch);
 	_swapk_insert_sorted_forward(sch, &sch->procqueue, proc);
+	_swapk_unlock_queue(sch);
 
 	return proc;
 }
@@ -198,183 +580,1103 @@ swapk_proc_t *swapk_push_proc(swapk_scheduler_t *sch,
 swapk_proc_t *swapk_ready_proc(swapk_scheduler_t *sch,
 			       swapk_proc_t *proc)
 {
-	if (!proc || proc->ready)
-		return NULL;
+	int placed;
 
-	proc->ready = true;
+	return _swapk_ready_proc(sch, proc, &placed);
+}
+
+swapk_pid_t swapk_proc_get_pid(swapk_scheduler_t *sch)
+{
+	swapk_proc_t *proc = swapk_proc_get(sch);
+
+	return proc->pid;
+}
+
+void swapk_proc_set_affinity(swapk_proc_t *proc, SWAPK_CORE_MASK_T mask,
+			     int preferred)
+{
+	proc->core_mask = mask;
+	proc->core_preferred = preferred;
+}
+
+SWAPK_HOT
+swapk_proc_t *swapk_proc_get(swapk_scheduler_t *sch)
+{
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+
+	return sch->current[cid]
+		? sch->current[cid]
+		: &sch->_system_proc;
+}
+
+void swapk_wait(swapk_scheduler_t *sch, SWAPK_ABSOLUTE_TIME_T time)
+{
+	swapk_proc_t *proc;
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+
+	/* Wait is expected to only be called by current proc */
+	proc = sch->current[cid] ? sch->current[cid] : &sch->_system_proc;
+	swapk_wait_proc(sch, time, proc);
+}
+
+void swapk_wait_proc(swapk_scheduler_t *sch, SWAPK_ABSOLUTE_TIME_T time,
+		     swapk_proc_t *proc)
+{
+	/* We don't want to remove the readiness of processes just
+	 * because they couldn't lock the scheduler */
+	if (!swapk_event_check(&sch->events[_swapk_core_id(sch->cb_list)],
+			       SWAPK_SYSTEM_EVENT_PREEMPT_DISABLED)) {
+		_swapk_lock_queue(sch);
+		proc->ready = false;
+		_swapk_requeue_locked(sch, proc);
+		_swapk_unlock_queue(sch);
+	}
+
+	if (_swapk_is_swapk_nowait(time))
+		return;
+
+	_swapk_block(sch, proc, time);
+}
+
+void swapk_wait_pid(swapk_scheduler_t *sch, SWAPK_ABSOLUTE_TIME_T time,
+		    swapk_pid_t pid)
+{
+	swapk_proc_t *proc = _swapk_find_pid(sch, pid);
+
+	proc = proc ? proc : &sch->_system_proc;
+	swapk_wait_proc(sch, time, proc);
+}
+
+SWAPK_HOT
+void swapk_notify(swapk_scheduler_t *sch, swapk_proc_t *wake_up_proc)
+{
+	int placed;
+
+	if (!_swapk_ready_proc(sch, wake_up_proc, &placed))
+		return;
+
+	_swapk_preempt_for(sch, wake_up_proc, placed);
+}
+
+bool swapk_futex_wait(swapk_scheduler_t *sch, volatile uint32_t *addr,
+		      uint32_t expected, SWAPK_ABSOLUTE_TIME_T time)
+{
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+
+	_swapk_lock_queue(sch);
+
+	if (*addr != expected) {
+		_swapk_unlock_queue(sch);
+		return true;
+	}
+
+	/* Buckets are shared, so remember which word we wait on */
+	if (sch->current[cid])
+		sch->current[cid]->_wait_data = (void*) addr;
+
+	return _swapk_waitlist_block(sch, _swapk_futex_bucket(sch, addr),
+				     time);
+}
+
+int swapk_futex_wake(swapk_scheduler_t *sch, volatile uint32_t *addr,
+		     int n)
+{
+	SWAPK_CORE_MASK_T kick;
+	int woken;
+
+	_swapk_lock_queue(sch);
+	kick = _swapk_futex_wake_locked(sch, addr, n, &woken);
+	_swapk_unlock_queue(sch);
+
+	_swapk_kick_mask(sch, kick);
+
+	return woken;
+}
+
+SWAPK_HOT
+int swapk_futex_wake_from_isr(swapk_scheduler_t *sch,
+			      volatile uint32_t *addr, int n)
+{
+	SWAPK_CORE_MASK_T kick;
+	int woken;
+
+	_swapk_lock_queue(sch);
+	kick = _swapk_futex_wake_locked(sch, addr, n, &woken);
+	_swapk_unlock_queue(sch);
+
+	_swapk_kick_mask_from_isr(sch, kick);
+
+	return woken;
+}
+
+SWAPK_HOT
+void swapk_notify_timeout_from_isr(swapk_scheduler_t *sch,
+				   swapk_proc_t *proc, uint32_t gen)
+{
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	bool stale;
+	int placed = SWAPK_CORE_NONE;
+
+	/* Checked and readied in one go, so the process can't end
+	 * this wait and start another in between */
+	_swapk_lock_queue(sch);
+
+	if (!(stale = proc->wait_gen != gen)) {
+		proc->_timed_out = true;
+		_swapk_ready_locked(sch, proc, &placed);
+	}
+
+	_swapk_unlock_queue(sch);
+
+	if (stale) {
+		++sch->stats[cid].stale_timeouts;
+		return;
+	}
+
+	if (placed != SWAPK_CORE_NONE)
+		_swapk_kick_mask_from_isr(sch, SWAPK_CORE_MASK(placed));
+}
+
+void swapk_notify_many(swapk_scheduler_t *sch, swapk_proc_t **procs,
+		       size_t n)
+{
+	SWAPK_CORE_MASK_T kick = 0;
+	int placed;
+
+	_swapk_lock_queue(sch);
+
+	for (size_t i = 0; i < n; ++i)
+		if (procs[i] && _swapk_ready_locked(sch, procs[i], &placed) &&
+		    placed != SWAPK_CORE_NONE)
+			kick |= SWAPK_CORE_MASK(placed);
+
+	_swapk_unlock_queue(sch);
+
+	_swapk_kick_mask(sch, kick);
+}
+
+SWAPK_HOT
+void swapk_notify_from_isr(swapk_scheduler_t *sch, swapk_proc_t *proc)
+{
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	swapk_proc_t *current;
+	uint32_t save;
+	uint8_t head;
+	bool pending;
+	int placed;
+
+	if (!proc)
+		return;
+
+	/* Nested handlers on this core are the only other writers */
+	save = swapk_irq_save();
+	head = sch->_isr_wake_head[cid];
+
+	if ((uint8_t) (head - sch->_isr_wake_tail[cid])
+	    < SWAPK_ISR_WAKE_SLOTS) {
+		sch->_isr_wake[cid][head % SWAPK_ISR_WAKE_SLOTS] = proc;
+		SWAPK_MEMORY_BARRIER();
+		sch->_isr_wake_head[cid] = head + 1;
+	} else {
+		/* Pay for the queue lock rather than lose the wake */
+		++sch->stats[cid].isr_wake_overflows;
+		_swapk_ready_proc(sch, proc, &placed);
+	}
+
+	pending = sch->_isr_wake_pending[cid];
+	sch->_isr_wake_pending[cid] = true;
+	swapk_irq_restore(save);
+
+	/* The pass already asked for picks this one up too */
+	if (pending)
+		return;
+
+	swapk_event_add(&sch->events[cid],
+			SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH);
+
+	/* A cooperative or locked process won't let this core take
+	 * the pass soon, so offer it to the idle ones as well */
+	current = sch->current[cid];
+
+#if SWAPK_HARDWARE_THREADS > 1
+	if (current && (current->priority < 0 ||
+			current->sched_lock_depth)) {
+		for (SWAPK_CORE_ID_T i = 0; i < SWAPK_HARDWARE_THREADS; ++i)
+			if (i != cid)
+				swapk_event_add(&sch->events[i],
+						SWAPK_SYSTEM_EVENT_SCH_AVAILABLE);
+
+		_swapk_kick_others(sch, cid);
+	}
+#else
+	(void) current;
+#endif
+
+	swapk_core_kicked(sch);
+}
+
+void swapk_notify_pid(swapk_scheduler_t *sch, swapk_pid_t pid)
+{
+	swapk_proc_t *proc = _swapk_find_pid(sch, pid);
+	swapk_notify(sch, proc);
+}
+
+void swapk_waitlist_init(swapk_waitlist_t *wl)
+{
+	TAILQ_INIT(&wl->procs);
+	wl->seq = 0;
+}
+
+uint32_t swapk_waitlist_prepare(swapk_waitlist_t *wl)
+{
+	return wl->seq;
+}
+
+bool swapk_waitlist_wait(swapk_scheduler_t *sch, swapk_waitlist_t *wl,
+			 uint32_t seq, SWAPK_ABSOLUTE_TIME_T time)
+{
+	_swapk_lock_queue(sch);
+
+	if (wl->seq != seq) {
+		_swapk_unlock_queue(sch);
+		return true;
+	}
+
+	return _swapk_waitlist_block(sch, wl, time);
+}
+
+void swapk_waitlist_notify_all(swapk_scheduler_t *sch,
+			       swapk_waitlist_t *wl)
+{
+	swapk_proc_t *proc;
+	SWAPK_CORE_MASK_T kick = 0;
+	int placed;
+
+	/* Empty the whole list in one critical section, so a proc is
+	 * never on it once we let go of the lock */
+	_swapk_lock_queue(sch);
+	++wl->seq;
+
+	while ((proc = TAILQ_FIRST(&wl->procs))) {
+		TAILQ_REMOVE(&wl->procs, proc, _wait_entry);
+		proc->_waitlist = NULL;
+
+		if (_swapk_ready_locked(sch, proc, &placed) &&
+		    placed != SWAPK_CORE_NONE)
+			kick |= SWAPK_CORE_MASK(placed);
+	}
+
+	_swapk_unlock_queue(sch);
+
+	_swapk_kick_mask(sch, kick);
+}
+
+bool swapk_join(swapk_scheduler_t *sch, swapk_proc_t *proc,
+		SWAPK_ABSOLUTE_TIME_T time, void **result)
+{
+	_swapk_lock_queue(sch);
+
+	return _swapk_join_locked(sch, proc, time, result);
+}
+
+bool swapk_join_pid(swapk_scheduler_t *sch, swapk_pid_t pid,
+		    SWAPK_ABSOLUTE_TIME_T time, void **result)
+{
+#if SWAPK_POOL_PROCS > 0
+	swapk_proc_t *proc = NULL;
+
+	_swapk_lock_queue(sch);
+
+	/* Reaped blocks have no PID, so a recycled one never matches */
+	for (int i = 0; i < SWAPK_POOL_PROCS; ++i)
+		if (pid != SWAPK_INVALID_PID &&
+		    sch->_pool_proc[i].pid == pid) {
+			proc = &sch->_pool_proc[i];
+			break;
+		}
+
+	if (!proc) {
+		_swapk_unlock_queue(sch);
+		return false;
+	}
+
+	return _swapk_join_locked(sch, proc, time, result);
+#else
+	(void) sch;
+	(void) pid;
+	(void) time;
+	(void) result;
+
+	return false;
+#endif /* #if SWAPK_POOL_PROCS > 0 */
+}
+
+void swapk_idle_till_ready(swapk_scheduler_t *sch)
+{
+	while (!_swapk_is_proc_ready(sch)) {
+		sch->cb_list->poll_event(sch);
+	}
+}
+
+SWAPK_HOT
+void swapk_yield(swapk_scheduler_t *sch)
+{
+	_swapk_yield(sch, false);
+}
+
+SWAPK_HOT
+void _swapk_yield(swapk_scheduler_t *sch, bool preempted)
+{
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	swapk_proc_t *current = sch->current[cid]
+		? sch->current[cid]
+		: &sch->_system_proc;
+
+	swapk_proc_t *next = &sch->_system_proc;
+
+	/* Do not allow a process to preempt itself */
+	if (current == next)
+		return;
+
+	/* The scheduler would only pick us again */
+	if (_swapk_still_best(sch, current)) {
+		++sch->stats[cid].yields_skipped;
+#if SWAPK_HARDWARE_THREADS > 1
+		/* That was the pass SCH_AVAILABLE asked for, so the
+		 * sleep process can go back to polling */
+		swapk_event_clear(&sch->events[cid],
+				  SWAPK_SYSTEM_EVENT_SCH_AVAILABLE);
+#endif
+		return;
+	}
+
+	if (preempted)
+		++sch->stats[cid].preemptions;
+	else
+		++sch->stats[cid].yields;
+
+#if SWAPK_COOPERATIVE_ONLY > 0
+	/* Nothing can preempt us on the way */
+	swapk_event_add(&sch->events[cid],
+			SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH);
+#else
+	/* Swap to system thread and signal need for context
+	 * shift. Entering needed to prevent notification loop */
+	swapk_event_add(&sch->events[cid],
+			SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH |
+			SWAPK_SYSTEM_EVENT_PREEMPT_DISABLED);
+#endif
+
+#if SWAPK_HARDWARE_THREADS > 1
+	/* If use the blocking version, we will just keep calling
+	 * swapk_yield() over and over again */
+	while (!sch->cb_list->sem_sch_take_non_blocking()) {
+		++sch->stats[cid].sem_spins;
+		_swapk_wait_for_scheduler(sch);
+	}
+#endif
+
+	_swapk_proc_swap(sch, current, next);
+}
+
+SWAPK_HOT
+void swapk_preempt(swapk_scheduler_t *sch)
+{
+#if SWAPK_COOPERATIVE_ONLY > 0
+	(void) sch;
+#else
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	swapk_proc_t *current = sch->current[cid]
+		? sch->current[cid]
+		: &sch->_system_proc;
+
+	/* Do not preempt a process with priority less than 0 */
+	if (current->priority < 0)
+		return;
+
+	/* Hold it until swapk_sched_unlock() */
+	if (current->sched_lock_depth) {
+		current->_sched_deferred = true;
+		return;
+	}
+
+	_swapk_yield(sch, true);
+#endif /* #if SWAPK_COOPERATIVE_ONLY > 0 */
+}
+
+SWAPK_HOT
+void swapk_sched_lock(swapk_scheduler_t *sch)
+{
+	/* Only this process writes its depth, and a preemption
+	 * between the load and store sees it unlocked anyway */
+	++swapk_proc_get(sch)->sched_lock_depth;
+	SWAPK_MEMORY_BARRIER();
+}
+
+SWAPK_HOT
+void swapk_sched_unlock(swapk_scheduler_t *sch)
+{
+	swapk_proc_t *self;
+
+	SWAPK_MEMORY_BARRIER();
+	self = swapk_proc_get(sch);
+
+	/* Unbalanced unlock, don't wrap the depth round */
+	if (!self->sched_lock_depth || --self->sched_lock_depth ||
+	    !self->_sched_deferred)
+		return;
+
+	self->_sched_deferred = false;
+	swapk_preempt(sch);
+}
+
+void swapk_sched_stats_snapshot(swapk_scheduler_t *sch,
+				SWAPK_CORE_ID_T cid,
+				swapk_sched_stats_t *out)
+{
+	/* Every counter is a uint32_t, so sum them as words */
+	uint32_t *dst = (uint32_t*) out;
+	const size_t words = sizeof(*out) / sizeof(uint32_t);
+
+	if (cid < SWAPK_HARDWARE_THREADS) {
+		*out = sch->stats[cid];
+		return;
+	}
+
+	memset(out, 0, sizeof(*out));
 
 	for (SWAPK_CORE_ID_T i = 0; i < SWAPK_HARDWARE_THREADS; ++i) {
-		swapk_event_add(&sch->events[i],
-				SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH);
+		const uint32_t *src = (const uint32_t*) &sch->stats[i];
+
+		for (size_t w = 0; w < words; ++w)
+			dst[w] += src[w];
+	}
+}
+
+void swapk_sched_stats_reset(swapk_scheduler_t *sch, SWAPK_CORE_ID_T cid)
+{
+	for (SWAPK_CORE_ID_T i = 0; i < SWAPK_HARDWARE_THREADS; ++i) {
+		if (cid < SWAPK_HARDWARE_THREADS && i != cid)
+			continue;
+
+		memset(&sch->stats[i], 0, sizeof(sch->stats[i]));
+	}
+}
+
+#if SWAPK_IRQ_TRACE > 0
+SWAPK_HOT
+void swapk_irq_trace_begin(uint32_t save, void *site)
+{
+	swapk_callbacks_t *cb = _swapk_irq_trace_cb;
+	SWAPK_CORE_ID_T cid;
+
+	/* Already masked, so this is not the outermost window */
+	if (!cb || !cb->get_ticks || (save & 1))
+		return;
+
+	cid = _swapk_core_id(cb);
+	_swapk_irq_trace[cid].site = site;
+	_swapk_irq_trace[cid].open = true;
+	++_swapk_irq_trace[cid].opened;
+	_swapk_irq_trace[cid].start = cb->get_ticks();
+}
+
+SWAPK_HOT
+void swapk_irq_trace_end(uint32_t save)
+{
+	swapk_callbacks_t *cb = _swapk_irq_trace_cb;
+	SWAPK_CORE_ID_T cid;
+	uint32_t ticks;
+
+	if (!cb || !cb->get_ticks || (save & 1))
+		return;
+
+	cid = _swapk_core_id(cb);
+	ticks = cb->get_ticks() - _swapk_irq_trace[cid].start;
+	_swapk_irq_trace[cid].open = false;
+	++_swapk_irq_trace[cid].trace.windows;
+
+	if (ticks > _swapk_irq_trace[cid].trace.max_ticks) {
+		_swapk_irq_trace[cid].trace.max_ticks = ticks;
+		_swapk_irq_trace[cid].trace.max_site =
+			_swapk_irq_trace[cid].site;
+	}
+}
+
+SWAPK_HOT
+uint32_t swapk_irq_save(void)
+{
+	uint32_t save = swapk_irq_save_untraced();
+
+	swapk_irq_trace_begin(save, __builtin_return_address(0));
+
+	return save;
+}
+
+SWAPK_HOT
+void swapk_irq_restore(uint32_t save)
+{
+	swapk_irq_trace_end(save);
+	swapk_irq_restore_untraced(save);
+}
+
+void swapk_irq_trace_read(SWAPK_CORE_ID_T cid, swapk_irq_trace_t *out)
+{
+	*out = _swapk_irq_trace[cid].trace;
+}
+
+void swapk_irq_trace_reset(SWAPK_CORE_ID_T cid)
+{
+	uint32_t save = swapk_irq_save_untraced();
+
+	memset(&_swapk_irq_trace[cid].trace, 0,
+	       sizeof(_swapk_irq_trace[cid].trace));
+	swapk_irq_restore_untraced(save);
+}
+
+#if SWAPK_COOPERATIVE_ONLY == 0
+/* swapk_pendsv_swap() masks for the whole register swap */
+SWAPK_HOT
+void _swapk_irq_trace_swap_begin(void)
+{
+	swapk_irq_trace_begin(0, (void*) swapk_pendsv_swap);
+}
+
+SWAPK_HOT
+void _swapk_irq_trace_swap_end(void)
+{
+	swapk_irq_trace_end(0);
+}
+#endif /* #if SWAPK_COOPERATIVE_ONLY == 0 */
+#endif /* #if SWAPK_IRQ_TRACE > 0 */
+
+void swapk_call_scheduler_available(swapk_scheduler_t *sch)
+{
+#if SWAPK_COOPERATIVE_ONLY > 0
+	/* We are still on the system stack, so the next process
+	 * gives the scheduler up once we are off it */
+	sch->_sch_release[_swapk_core_id(sch->cb_list)]
+		= SWAPK_HARDWARE_THREADS > 1;
+#elif SWAPK_HARDWARE_THREADS > 1
+	sch->_call_argc = 2;
+	sch->_call_argv[0] = (void*) sch->_call;
+	sch->_call_argv[1] = (void*) sch;
+	sch->_call_argv[2] = NULL;
+	_swapk_call_common(sch, _swapk_call_scheduler_available);
+#else
+	/* Nobody else can be waiting for the scheduler, so skip the
+	 * system call and the semaphore */
+	swapk_event_clear(&sch->events[0],
+			  SWAPK_SYSTEM_EVENT_PREEMPT_DISABLED);
+#endif
+}
+
+SWAPK_HOT
+void swapk_core_kicked(swapk_scheduler_t *sch)
+{
+#if SWAPK_COOPERATIVE_ONLY > 0
+	/* Only an idle core can act on a kick, and the interrupt has
+	 * already woken it from poll_event */
+	(void) sch;
+#else
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	swapk_proc_t *current = sch->current[cid];
+
+	/* Nothing to do if the scheduler already owns this core, the
+	 * process is cooperative, or it is on its way to the
+	 * scheduler anyway */
+	if (!current || current->priority < 0 ||
+	    !swapk_event_check(&sch->events[cid],
+			       SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH) ||
+	    swapk_event_check(&sch->events[cid],
+			      SWAPK_SYSTEM_EVENT_PREEMPT_DISABLED))
+		return;
+
+	if (current->sched_lock_depth) {
+		current->_sched_deferred = true;
+		return;
+	}
+
+	swapk_event_add(&sch->events[cid],
+			SWAPK_SYSTEM_EVENT_PREEMPT_DISABLED);
+
+#if SWAPK_HARDWARE_THREADS > 1
+	/* We are in an interrupt, so never spin here. If the
+	 * scheduler is busy it will kick us again once it is
+	 * available */
+	if (!sch->cb_list->sem_sch_take_non_blocking()) {
+		swapk_event_clear(&sch->events[cid],
+				  SWAPK_SYSTEM_EVENT_PREEMPT_DISABLED);
+		return;
+	}
+#endif
+
+	++sch->stats[cid].preemptions;
+	_swapk_proc_swap(sch, current, &sch->_system_proc);
+#endif /* #if SWAPK_COOPERATIVE_ONLY > 0 */
+}
+
+void swapk_event_init(swapk_event_t *event, uint32_t eventmask) {
+	event->active = eventmask;
+	event->fresh = false;
+}
+
+SWAPK_HOT
+bool swapk_event_check(swapk_event_t *event, uint32_t eventmask)
+{
+	event->fresh = false;
+	return event->active & eventmask;
+}
+
+SWAPK_HOT
+void swapk_event_add(swapk_event_t *event, uint32_t eventmask)
+{
+	event->active |= eventmask;
+	event->fresh = true;
+}
+
+SWAPK_HOT
+void swapk_event_clear(swapk_event_t *event, uint32_t eventmask)
+{
+	event->active &= ~eventmask;
+	event->fresh = false;
+}
+
+void swapk_event_clear_all(swapk_event_t *event)
+{
+	event->active = 0;
+	event->fresh = false;
+}
+
+void swapk_scheduler_sort(swapk_scheduler_t *sch)
+{
+	_swapk_lock_queue(sch);
+	_swapk_queue_sort(sch);
+	_swapk_unlock_queue(sch);
+}
+
+/*
+**********************************************************************
+*                                                                    *
+*                    Internal API Implementation                     *
+*                                                                    *
+**********************************************************************
+*/
+
+SWAPK_HOT
+#if SWAPK_IRQ_TRACE > 0
+__attribute__((noinline)) /* Keeps our return address the caller's */
+#endif
+void _swapk_lock_queue(swapk_scheduler_t *sch)
+{
+#if SWAPK_IRQ_TRACE > 0
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	uint32_t opened = _swapk_irq_trace[cid].opened;
+#endif
+
+	if (sch->cb_list->mutex_lock_queue)
+		sch->cb_list->mutex_lock_queue();
+
+#if SWAPK_IRQ_TRACE > 0
+	/* The port can only see that the lock was taken from here, so
+	 * if its lock opened a window, name the function that wanted
+	 * the lock instead. Still masked, so the window is ours */
+	if (_swapk_core_id(sch->cb_list) == cid &&
+	    _swapk_irq_trace[cid].open &&
+	    _swapk_irq_trace[cid].opened != opened)
+		_swapk_irq_trace[cid].site = __builtin_return_address(0);
+#endif
+}
+
+SWAPK_HOT
+void _swapk_unlock_queue(swapk_scheduler_t *sch)
+{
+	if (sch->cb_list->mutex_unlock_queue)
+		sch->cb_list->mutex_unlock_queue();
+}
+
+/* Kicks only ever target another core, so there is nothing to do on
+ * single core builds */
+SWAPK_HOT
+void _swapk_kick_core(swapk_scheduler_t *sch, SWAPK_CORE_ID_T cid)
+{
+#if SWAPK_HARDWARE_THREADS > 1
+	if (sch->cb_list->core_kick)
+		sch->cb_list->core_kick(cid);
+	else
+		sch->cb_list->signal_event(sch);
+#else
+	(void) sch;
+	(void) cid;
+#endif
+}
+
+SWAPK_HOT
+swapk_waitlist_t *_swapk_futex_bucket(swapk_scheduler_t *sch,
+				      volatile uint32_t *addr)
+{
+	uintptr_t key = (uintptr_t) addr >> 2;
+
+	return &sch->_futex[(key ^ (key >> 7)) & (SWAPK_FUTEX_BUCKETS - 1)];
+}
+
+/* Caller must hold the queue lock. Oldest waiters go first */
+SWAPK_HOT
+SWAPK_CORE_MASK_T _swapk_futex_wake_locked(swapk_scheduler_t *sch,
+					   volatile uint32_t *addr,
+					   int n, int *woken)
+{
+	swapk_waitlist_t *wl = _swapk_futex_bucket(sch, addr);
+	SWAPK_CORE_MASK_T kick = 0;
+	swapk_proc_t *proc;
+	swapk_proc_t *tproc;
+	int placed;
+
+	*woken = 0;
+
+	TAILQ_FOREACH_SAFE(proc, &wl->procs, _wait_entry, tproc) {
+		if (*woken >= n)
+			break;
+
+		if (proc->_wait_data != (void*) addr)
+			continue;
+
+		TAILQ_REMOVE(&wl->procs, proc, _wait_entry);
+		proc->_waitlist = NULL;
+		++*woken;
+
+		if (_swapk_ready_locked(sch, proc, &placed) &&
+		    placed != SWAPK_CORE_NONE)
+			kick |= SWAPK_CORE_MASK(placed);
 	}
 
-	sch->cb_list->signal_event(sch);
+	return kick;
+}
+
+/* Kick each other core in mask once, and preempt this one if a
+ * wake was placed here */
+SWAPK_HOT
+void _swapk_kick_mask(swapk_scheduler_t *sch, SWAPK_CORE_MASK_T mask)
+{
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+
+	for (SWAPK_CORE_ID_T i = 0; i < SWAPK_HARDWARE_THREADS; ++i)
+		if (i != cid && (mask & SWAPK_CORE_MASK(i)))
+			_swapk_kick_core(sch, i);
 
-	return proc;
+	if (mask & SWAPK_CORE_MASK(cid))
+		_swapk_preempt_for(sch, NULL, cid);
 }
 
-swapk_pid_t swapk_proc_get_pid(swapk_scheduler_t *sch)
+/* _swapk_kick_mask() for interrupt handlers, never waiting on the
+ * scheduler */
+SWAPK_HOT
+void _swapk_kick_mask_from_isr(swapk_scheduler_t *sch,
+			       SWAPK_CORE_MASK_T mask)
 {
-	swapk_proc_t *proc = swapk_proc_get(sch);
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
 
-	return proc->pid;
+	for (SWAPK_CORE_ID_T i = 0; i < SWAPK_HARDWARE_THREADS; ++i)
+		if (i != cid && (mask & SWAPK_CORE_MASK(i)))
+			_swapk_kick_core(sch, i);
+
+	/* CONTEXT_SWITCH is already set, so just try for the core */
+	if (mask & SWAPK_CORE_MASK(cid))
+		swapk_core_kicked(sch);
 }
 
-swapk_proc_t *swapk_proc_get(swapk_scheduler_t *sch)
+#if SWAPK_HARDWARE_THREADS > 1
+void _swapk_kick_others(swapk_scheduler_t *sch, SWAPK_CORE_ID_T cid)
 {
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
+	/* Without targeted kicks fall back to a single broadcast */
+	if (!sch->cb_list->core_kick) {
+		sch->cb_list->signal_event(sch);
+		return;
+	}
 
-	return sch->current[cid]
-		? sch->current[cid]
-		: &sch->_system_proc;
+	for (SWAPK_CORE_ID_T i = 0; i < SWAPK_HARDWARE_THREADS; ++i)
+		if (i != cid)
+			_swapk_kick_core(sch, i);
 }
+#endif /* #if SWAPK_HARDWARE_THREADS > 1 */
 
-void swapk_wait(swapk_scheduler_t *sch, SWAPK_ABSOLUTE_TIME_T time)
+SWAPK_HOT
+swapk_proc_t *_swapk_ready_proc(swapk_scheduler_t *sch,
+				swapk_proc_t *proc, int *placed)
 {
-	swapk_proc_t *proc;
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
+	bool woke;
 
-	/* Wait is expected to only be called by current proc */
-	proc = sch->current[cid] ? sch->current[cid] : &sch->_system_proc;
-	swapk_wait_proc(sch, time, proc);
+	*placed = SWAPK_CORE_NONE;
+
+	if (!proc)
+		return NULL;
+
+	_swapk_lock_queue(sch);
+	woke = _swapk_ready_locked(sch, proc, placed);
+	_swapk_unlock_queue(sch);
+
+	if (!woke)
+		return NULL;
+
+	/* Kick outside the critical section so the other core can
+	 * take the queue as soon as it wakes. The calling core is
+	 * left to the caller (see swapk_notify()) */
+	if (*placed != SWAPK_CORE_NONE &&
+	    *placed != _swapk_core_id(sch->cb_list))
+		_swapk_kick_core(sch, *placed);
+
+	return proc;
 }
 
-void swapk_wait_proc(swapk_scheduler_t *sch, SWAPK_ABSOLUTE_TIME_T time,
-		     swapk_proc_t *proc)
+/* Caller must hold the queue lock. Marks proc ready and decides
+ * who should run it. At most one core is told to reschedule and
+ * its id is returned through placed, or SWAPK_CORE_NONE if nothing
+ * running needs to make way. Kicking that core is left to the
+ * caller */
+SWAPK_HOT
+bool _swapk_ready_locked(swapk_scheduler_t *sch, swapk_proc_t *proc,
+			 int *placed)
 {
-	/* We don't want to remove the readiness of processes just
-	 * because they couldn't lock the scheduler */
-	if (!swapk_event_check(&sch->events[sch->cb_list->core_get_id()],
-			       SWAPK_SYSTEM_EVENT_PREEMPT_DISABLED))
-		proc->ready = false;
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
 
-	if (_swapk_is_swapk_nowait(time))
-		return;
+	*placed = SWAPK_CORE_NONE;
 
-	if (!_swapk_is_swapk_forever(time))
-		sch->cb_list->set_alarm(time, proc);
+	if (proc->ready)
+		return false;
 
-	swapk_yield(sch);
+	proc->ready = true;
+	_swapk_requeue_locked(sch, proc);
+
+#if SWAPK_PROC_HISTOGRAMS > 0
+	_swapk_hist_ready(sch->cb_list, proc);
+#endif
+
+	if ((*placed = _swapk_find_idle_core(sch, proc)) != SWAPK_CORE_NONE)
+		++sch->stats[cid].idle_wakeups;
+	else
+		*placed = _swapk_find_preempt_core(sch, proc);
+
+	if (*placed != SWAPK_CORE_NONE)
+		swapk_event_add(&sch->events[*placed],
+				SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH);
+	else
+		++sch->stats[cid].preempts_avoided;
+
+	return true;
 }
 
-void swapk_wait_pid(swapk_scheduler_t *sch, SWAPK_ABSOLUTE_TIME_T time,
-		    swapk_pid_t pid)
+/* Caller must hold the queue lock. Moves a queued proc whose
+ * readiness just changed to its sorted place, so the queue stays
+ * ordered between scheduler passes and _swapk_still_best() need
+ * only look at the head. Procs not in the queue are left alone */
+SWAPK_HOT
+void _swapk_requeue_locked(swapk_scheduler_t *sch, swapk_proc_t *proc)
 {
-	swapk_proc_t *proc = _swapk_find_pid(sch, pid);
+	swapk_proc_t *elem;
 
-	proc = proc ? proc : &sch->_system_proc;
-	swapk_wait_proc(sch, time, proc);
+	TAILQ_FOREACH(elem, &sch->procqueue, _tailq_entry)
+		if (elem == proc) {
+			TAILQ_REMOVE(&sch->procqueue, proc, _tailq_entry);
+			_swapk_insert_sorted_forward(sch, &sch->procqueue,
+						     proc);
+			return;
+		}
 }
 
-void swapk_notify(swapk_scheduler_t *sch, swapk_proc_t *wake_up_proc)
+/* Preempt the calling core for a proc that was just readied, if
+ * it was placed here */
+SWAPK_HOT
+void _swapk_preempt_for(swapk_scheduler_t *sch, swapk_proc_t *proc,
+			int placed)
 {
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
-	if (!swapk_ready_proc(sch, wake_up_proc))
+#if SWAPK_COOPERATIVE_ONLY > 0
+	/* It runs once the core next yields */
+	(void) sch;
+	(void) proc;
+	(void) placed;
+#else
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	swapk_proc_t *current;
+
+	/* Another core is picking it up, or it doesn't need to run
+	 * before anything that is running now */
+	if (placed != cid)
 		return;
 
+	current = sch->current[cid] ? sch->current[cid] : &sch->_system_proc;
+
 	/* Don't preempt if same process or on the way to the
 	 * scheduler */
-	if (wake_up_proc == sch->current[cid] ||
+	if (proc == current ||
 	    swapk_event_check(&sch->events[cid],
 			      SWAPK_SYSTEM_EVENT_PREEMPT_DISABLED))
 		return;
 
 	swapk_preempt(sch);
+#endif /* #if SWAPK_COOPERATIVE_ONLY > 0 */
 }
 
-void swapk_notify_pid(swapk_scheduler_t *sch, swapk_pid_t pid)
+void _swapk_block(swapk_scheduler_t *sch, swapk_proc_t *proc,
+		  SWAPK_ABSOLUTE_TIME_T time)
 {
-	swapk_proc_t *proc = _swapk_find_pid(sch, pid);
-	swapk_notify(sch, proc);
-}
+	SWAPK_CORE_ID_T cid;
+	bool timed = !_swapk_is_swapk_forever(time);
 
-void swapk_idle_till_ready(swapk_scheduler_t *sch)
-{
-	while (!_swapk_is_proc_ready(sch)) {
-		sch->cb_list->poll_event(sch);
+	if (timed) {
+		proc->_timed_out = false;
+		sch->cb_list->set_alarm(time, proc);
 	}
-}
-
-void swapk_yield(swapk_scheduler_t *sch)
-{
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
-	swapk_proc_t *current = sch->current[cid]
-		? sch->current[cid]
-		: &sch->_system_proc;
 
-	swapk_proc_t *next = &sch->_system_proc;
+	swapk_yield(sch);
 
-	/* Do not allow a process to preempt itself */
-	if (current == next)
+	if (!timed)
 		return;
 
-	/* Swap to system thread and signal need for context
-	 * shift. Entering needed to prevent notification loop */
-	swapk_event_add(&sch->events[cid],
-			SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH |
-			SWAPK_SYSTEM_EVENT_PREEMPT_DISABLED);
+	cid = _swapk_core_id(sch->cb_list);
 
-	/* If use the blocking version, we will just keep calling
-	 * swapk_yield() over and over again */
-	while (!sch->cb_list->sem_sch_take_non_blocking())
-		_swapk_wait_for_scheduler(sch);
+	/* Woken early, so the alarm would only wake a later wait */
+	if (!proc->_timed_out && sch->cb_list->cancel_alarm) {
+		sch->cb_list->cancel_alarm(proc);
+		++sch->stats[cid].alarms_cancelled;
+	}
 
-	_swapk_proc_swap(sch, current, next);
+	/* Whatever is still in flight for this wait is stale now */
+	_swapk_lock_queue(sch);
+	++proc->wait_gen;
+	_swapk_unlock_queue(sch);
 }
 
-void swapk_preempt(swapk_scheduler_t *sch)
+/* Caller must hold the queue lock, which is released. Returns true
+ * if a notify took us off the list, false on timeout */
+bool _swapk_waitlist_block(swapk_scheduler_t *sch, swapk_waitlist_t *wl,
+			   SWAPK_ABSOLUTE_TIME_T time)
 {
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
-	swapk_proc_t *current = sch->current[cid]
-		? sch->current[cid]
-		: &sch->_system_proc;
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	swapk_proc_t *self = sch->current[cid];
+	bool woken;
+
+	/* The system process can't block */
+	if (!self || _swapk_is_swapk_nowait(time)) {
+		_swapk_unlock_queue(sch);
+		return false;
+	}
 
-	/* Do not preempt a process with priority less than 0 */
-	if (current->priority < 0)
-		return;
+	/* Not ready before the lock is dropped, so a notify from
+	 * here on is never lost */
+	self->ready = false;
+	self->_waitlist = wl;
+	TAILQ_INSERT_TAIL(&wl->procs, self, _wait_entry);
+	_swapk_unlock_queue(sch);
 
-	swapk_yield(sch);
-}
+	for (;;) {
+		_swapk_block(sch, self, time);
 
-void swapk_call_scheduler_available(swapk_scheduler_t *sch)
-{
-	sch->_call_argc = 2;
-	sch->_call_argv[0] = (void*) sch->_call;
-	sch->_call_argv[1] = (void*) sch;
-	sch->_call_argv[2] = NULL;
-	_swapk_call_common(sch, _swapk_call_scheduler_available);
-}
+		_swapk_lock_queue(sch);
 
-void swapk_event_init(swapk_event_t *event, uint32_t eventmask) {
-	event->active = eventmask;
-	event->fresh = false;
+		if ((woken = !self->_waitlist))
+			break;
+
+		/* Still listed, so some other notify woke us. Only the
+		 * alarm ends the wait, and ports without cancel_alarm
+		 * can't tell theirs apart, so take any wake as it */
+		if (!_swapk_is_swapk_forever(time) &&
+		    (self->_timed_out || !sch->cb_list->cancel_alarm)) {
+			TAILQ_REMOVE(&wl->procs, self, _wait_entry);
+			self->_waitlist = NULL;
+			break;
+		}
+
+		self->ready = false;
+		_swapk_unlock_queue(sch);
+	}
+
+	_swapk_unlock_queue(sch);
+
+	return woken;
 }
 
-bool swapk_event_check(swapk_event_t *event, uint32_t eventmask)
+/* Caller must hold the queue lock. Tries the core proc favours
+ * first so an idle wakeup doesn't cause a migration */
+SWAPK_HOT
+int _swapk_find_idle_core(swapk_scheduler_t *sch, swapk_proc_t *proc)
 {
-	event->fresh = false;
-	return event->active & eventmask;
+	int first = proc->core_preferred >= 0
+		? proc->core_preferred
+		: proc->core_last;
+
+	if (first >= 0 && _swapk_is_core_idle(sch, proc, first))
+		return first;
+
+	for (int i = 0; i < SWAPK_HARDWARE_THREADS; ++i)
+		if (_swapk_is_core_idle(sch, proc, i))
+			return i;
+
+	return SWAPK_CORE_NONE;
 }
 
-void swapk_event_add(swapk_event_t *event, uint32_t eventmask)
+SWAPK_HOT
+bool _swapk_is_core_idle(swapk_scheduler_t *sch, swapk_proc_t *proc,
+			 int cid)
 {
-	event->active |= eventmask;
-	event->fresh = true;
+	return cid < SWAPK_HARDWARE_THREADS &&
+		(proc->core_mask & SWAPK_CORE_MASK(cid)) &&
+		sch->current[cid] == &sch->_sleep_proc[cid];
 }
 
-void swapk_event_clear(swapk_event_t *event, uint32_t eventmask)
+/* Caller must hold the queue lock. Picks the core running the
+ * lowest priority process proc should run before, favouring the
+ * core proc would rather be on */
+SWAPK_HOT
+int _swapk_find_preempt_core(swapk_scheduler_t *sch, swapk_proc_t *proc)
 {
-	event->active &= ~eventmask;
-	event->fresh = false;
+	int target = SWAPK_CORE_NONE;
+	swapk_proc_t *victim = NULL;
+
+	for (int i = 0; i < SWAPK_HARDWARE_THREADS; ++i) {
+		swapk_proc_t *running = sch->current[i];
+
+		if (!(proc->core_mask & SWAPK_CORE_MASK(i)))
+			continue;
+
+		/* The scheduler is already there and will see proc */
+		if (!running)
+			return i;
+
+		/* Cooperative procs can't be preempted, and equals
+		 * wait their turn */
+		if (running->priority < 0 ||
+		    proc->priority >= running->priority)
+			continue;
+
+		if (!victim || running->priority > victim->priority ||
+		    (running->priority == victim->priority &&
+		     _swapk_prefers_core(proc, i))) {
+			victim = running;
+			target = i;
+		}
+	}
+
+	return target;
 }
 
-void swapk_event_clear_all(swapk_event_t *event)
+/* Caller must hold the queue lock */
+SWAPK_HOT
+swapk_proc_t *_swapk_queue_pop(swapk_scheduler_t *sch)
 {
-	event->active = 0;
-	event->fresh = false;
+	swapk_proc_t *ret;
+
+	if (TAILQ_EMPTY(&sch->procqueue))
+		return NULL;
+
+	ret = TAILQ_FIRST(&sch->procqueue);
+	TAILQ_REMOVE(&sch->procqueue, ret, _tailq_entry);
+
+	return ret;
 }
 
-void swapk_scheduler_sort(swapk_scheduler_t *sch)
+/* Caller must hold the queue lock */
+SWAPK_HOT
+void _swapk_queue_sort(swapk_scheduler_t *sch)
 {
 	/* Sort processes */
 	swapk_proc_t *elem;
@@ -384,6 +1686,8 @@ void swapk_scheduler_sort(swapk_scheduler_t *sch)
 	struct swapk_proc_queue *q = &sch->procqueue;
 	struct swapk_proc_queue tq;
 
+	++sch->stats[_swapk_core_id(sch->cb_list)].sorts;
+
 	/* Merge type sort with components pushed and sorted onto a
 	 * new list */
 	TAILQ_INIT(&tq);
@@ -397,14 +1701,7 @@ void swapk_scheduler_sort(swapk_scheduler_t *sch)
 	TAILQ_SWAP(&tq, q, swapk_proc_node, _tailq_entry);
 }
 
-/*
-**********************************************************************
-*                                                                    *
-*                    Internal API Implementation                     *
-*                                                                    *
-**********************************************************************
-*/
-
+SWAPK_HOT
 int _swapk_proc_compare(swapk_scheduler_t *sch, swapk_proc_t *proca,
 			swapk_proc_t *procb)
 {
@@ -413,7 +1710,7 @@ int _swapk_proc_compare(swapk_scheduler_t *sch, swapk_proc_t *proca,
 	const int rea = 0x04;
 	const int pri = 0x02;
 	const int aff = 0x01;
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
 
 	/* If procb belongs right of proca, > 1, 0 if belong in same
 	 * place, < 1 if proca belongs right of procb */
@@ -440,118 +1737,297 @@ int _swapk_proc_compare(swapk_scheduler_t *sch, swapk_proc_t *proca,
 	if (procb->ready)
 		order -= rea;
 
-	/* Core affinity */
-	if (proca->core_affinity == cid + 1 ||
-	    proca->core_affinity == -1 * (cid + 1))
+	/* Core affinity, so ties go to procs that won't migrate */
+	if (_swapk_prefers_core(proca, cid))
 		order += aff;
 
-	if (procb->core_affinity == cid + 1 ||
-	    procb->core_affinity == -1 * (cid + 1))
+	if (_swapk_prefers_core(procb, cid))
 		order -= aff;
 
 	return order;
 }
 
+SWAPK_HOT
 bool _swapk_is_proc_ready(swapk_scheduler_t *sch)
 {
 	swapk_proc_t *elem;
+	bool ret = false;
+
+	_swapk_lock_queue(sch);
 
 	TAILQ_FOREACH(elem, &sch->procqueue, _tailq_entry)
 		if (elem->ready) {
-			return true;
+			ret = true;
+			break;
 		}
 
-	return false;
+	_swapk_unlock_queue(sch);
+
+	return ret;
 }
 
+SWAPK_HOT
 void *_swapk_system_entry(void* arg)
 {
 	swapk_scheduler_t *sch = (swapk_scheduler_t*) arg;
 	swapk_proc_t * proc = NULL;
 	SWAPK_CORE_ID_T cid;
 
+#if SWAPK_HARDWARE_THREADS > 1
 	sch->cb_list->sem_sch_take_blocking();
+#endif
 
 	for (;;) {
-		cid = sch->cb_list->core_get_id();
+		cid = _swapk_core_id(sch->cb_list);
 
 		if ((proc = sch->_last[cid])) {
-			swapk_push_proc(sch, proc);
+			/* We are off its stack now, so an exited proc
+			 * can be recycled */
+			if (proc->exited)
+				_swapk_reap_proc(sch, proc);
+			else
+				swapk_push_proc(sch, proc);
+
 			sch->_last[cid] = NULL;
 		}
 
 		if (_swapk_maybe_switch_context(sch)) {
+#if SWAPK_HARDWARE_THREADS > 1
 			for (SWAPK_CORE_ID_T i = 0;
 			     i < SWAPK_HARDWARE_THREADS; ++i) {
 				swapk_event_clear(&sch->events[i],
 						  SWAPK_SYSTEM_EVENT_SCH_AVAILABLE);
 			}
+#endif
 
+#if SWAPK_COOPERATIVE_ONLY == 0
 			/* Currently only an SVC call can disable, so
 			 * we need to do this to make sure the
 			 * scheduler isn't interrupted before
 			 * pendsv */
 			swapk_svc_disable();
+#endif
 		}
 	}
 
 	return arg;
 }
 
+/* Entered with the entry function's return value in r0, which is
+ * not necessarily the scheduler, so look it up from the core */
 void _swapk_end_proc(void *arg)
 {
-	swapk_scheduler_t *sch = (swapk_scheduler_t*) arg;
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
-	swapk_proc_t *current = sch->current[cid];
-	/* swapk_proc_t *next; */
+	swapk_scheduler_t *sch = scheduler_ptr[_swapk_core_id(_swapk_cbptr)];
 
-	current->ready = false;
-	/* next = &sch->_system_proc; */
-	/* sch->context_shift[cid] = true; */
-	/* sch->current[cid] = NULL; */
+	/* arg is whatever the entry left in r0, i.e. its result */
+	swapk_proc_exit(sch, arg);
+}
+
+void _swapk_proc_setup(swapk_scheduler_t *sch, swapk_proc_t *proc,
+		       swapk_stack_t *stack, swapk_entry entry,
+		       void *arg, int priority)
+{
+	proc->stack = stack;
+	proc->ready = true;
+	proc->priority = priority;
+	proc->entry = entry;
+	proc->core_mask = SWAPK_CORE_MASK_ANY;
+	proc->core_preferred = SWAPK_CORE_NONE;
+	proc->core_id = -1;
+	proc->core_last = -1;
+	proc->migrations = 0;
+	proc->exited = false;
+	proc->result = NULL;
+	proc->sched_lock_depth = 0;
+	proc->_waitlist = NULL;
+	proc->_timed_out = false;
+	proc->_sched_deferred = false;
+#if SWAPK_PROC_HISTOGRAMS > 0
+	proc->_ready_stamped = false;
+	proc->_run_stamped = false;
+	swapk_proc_hist_reset(proc);
+#endif
+	swapk_waitlist_init(&proc->joiners);
+
+	/* Not reset, so an alarm left from a previous user of a
+	 * pooled block is stale */
+	++proc->wait_gen;
+
+	_swapk_lock_queue(sch);
+
+	if ((proc->pid = sch->proc_cnt++) == SWAPK_INVALID_PID)
+		proc->pid = sch->proc_cnt++;
+
+	_swapk_unlock_queue(sch);
 
-	/* Switch to system proc */
-	/* _swapk_proc_swap(sch, current, next); */
+	swapk_register_proc(proc->entry, &proc->stack->stackptr,
+			    _swapk_end_proc, arg);
+	swapk_push_proc(sch, proc);
+}
 
-	/* We shouldn't get here */
-	for (;;) {
-		swapk_yield(sch);
-		sch->current[sch->cb_list->core_get_id()]->ready = false;
-		/* sch->cb_list->poll_event(arg); */
+/* Only called by the scheduler once it is off the proc's stack */
+void _swapk_reap_proc(swapk_scheduler_t *sch, swapk_proc_t *proc)
+{
+	_swapk_lock_queue(sch);
+
+#if SWAPK_POOL_PROCS > 0
+	/* Static processes keep their PID so late joiners still find
+	 * them exited. Pooled ones lose it, so swapk_join_pid() can't
+	 * match whatever the block is spawned as next */
+	if (proc->pool_class != SWAPK_POOL_NONE) {
+		proc->pid = SWAPK_INVALID_PID;
+		TAILQ_INSERT_HEAD(&sch->_pool_free[proc->pool_class], proc,
+				  _tailq_entry);
+	}
+#else
+	(void) proc;
+#endif /* #if SWAPK_POOL_PROCS > 0 */
+
+	_swapk_unlock_queue(sch);
+}
+
+/* Caller must hold the queue lock, which is released */
+bool _swapk_join_locked(swapk_scheduler_t *sch, swapk_proc_t *proc,
+			SWAPK_ABSOLUTE_TIME_T time, void **result)
+{
+	swapk_proc_t *self = swapk_proc_get(sch);
+
+	/* Checked first, as a reaped static process keeps its result */
+	if (proc->exited) {
+		if (result)
+			*result = proc->result;
+
+		_swapk_unlock_queue(sch);
+		return true;
+	}
+
+	if (proc == self || proc->pid == SWAPK_INVALID_PID) {
+		_swapk_unlock_queue(sch);
+		return false;
+	}
+
+	if (!_swapk_waitlist_block(sch, &proc->joiners, time))
+		return false;
+
+	if (result)
+		*result = self->_wait_data;
+
+	return true;
+}
+
+void _swapk_pool_init(swapk_scheduler_t *sch)
+{
+#if SWAPK_POOL_PROCS > 0
+	for (int i = 0; i < SWAPK_POOL_CLASSES; ++i)
+		TAILQ_INIT(&sch->_pool_free[i]);
+
+	for (int i = 0; i < SWAPK_POOL_PROCS; ++i) {
+		swapk_proc_t *proc = &sch->_pool_proc[i];
+		swapk_stack_t *stack = &sch->_pool_stack[i];
+
+#if SWAPK_POOL_SMALL_PROCS > 0
+		if (i < SWAPK_POOL_SMALL_PROCS) {
+			proc->pool_class = SWAPK_POOL_SMALL;
+			stack->stackbase = sch->_pool_small_stack_data[i];
+		}
+#endif
+#if SWAPK_POOL_LARGE_PROCS > 0
+		if (i >= SWAPK_POOL_SMALL_PROCS) {
+			proc->pool_class = SWAPK_POOL_LARGE;
+			stack->stackbase = sch->_pool_large_stack_data
+				[i - SWAPK_POOL_SMALL_PROCS];
+		}
+#endif
+		stack->stacksize = _swapk_pool_stack_size[proc->pool_class];
+		memset(stack->stackbase, SWAPK_STACK_PAINT, stack->stacksize);
+		proc->stack = stack;
+		proc->pid = SWAPK_INVALID_PID;
+		proc->ready = false;
+		proc->exited = true;
+		proc->_waitlist = NULL;
+		swapk_waitlist_init(&proc->joiners);
+		TAILQ_INSERT_TAIL(&sch->_pool_free[proc->pool_class], proc,
+				  _tailq_entry);
 	}
+#else
+	(void) sch;
+#endif /* #if SWAPK_POOL_PROCS > 0 */
 }
 
+SWAPK_HOT
 void _swapk_proc_swap(swapk_scheduler_t *sch, swapk_proc_t *current,
 		      swapk_proc_t *next)
 {
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
 
 	if (current == next)
 		return;
 
-	sch->_current[cid] = current;
-	sch->_next[cid] = next;
+	if (next != &sch->_system_proc)
+		++sch->stats[cid].context_switches;
+
 	scheduler_ptr[cid] = sch;
 	_swapk_cbptr = sch->cb_list;
+
+#if SWAPK_COOPERATIVE_ONLY > 0
+	/* What isr_irq14() does for the preemptive kernel */
+	sch->_last[cid] = current == &sch->_system_proc ? NULL : current;
+	sch->current[cid] = next == &sch->_system_proc ? NULL : next;
+	current->core_id = -1;
+	next->core_id = cid;
+
+#if SWAPK_PROC_HISTOGRAMS > 0
+	_swapk_hist_switch(sch->cb_list, current, next);
+#endif
+
+	swapk_context_swap(&current->stack->stackptr,
+			   next->stack->stackptr);
+
+	/* Back on current's stack, maybe on another core */
+	_swapk_switch_finish();
+#else
+	sch->_current[cid] = current;
+	sch->_next[cid] = next;
 	swapk_set_pending();
+#endif
+}
+
+/* Runs on the new process's stack after every cooperative switch,
+ * or first thing for a new process */
+SWAPK_HOT
+void _swapk_switch_finish(void)
+{
+#if SWAPK_COOPERATIVE_ONLY > 0 && SWAPK_HARDWARE_THREADS > 1
+	SWAPK_CORE_ID_T cid = _swapk_core_id(_swapk_cbptr);
+	swapk_scheduler_t *sch = scheduler_ptr[cid];
+
+	if (sch->_sch_release[cid]) {
+		sch->_sch_release[cid] = false;
+		_swapk_scheduler_available(sch);
+	}
+#endif
 }
 
 swapk_proc_t *_swapk_find_pid(swapk_scheduler_t *sch,
 			      swapk_pid_t pid)
 {
 	swapk_proc_t *proc = NULL;
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
 
 	if (sch->current[cid] && sch->current[cid]->pid == pid) {
 		proc = sch->current[cid];
 	} else {
 		swapk_proc_t *elem;
 
+		_swapk_lock_queue(sch);
+
 		TAILQ_FOREACH(elem, &sch->procqueue, _tailq_entry)
 			if (elem->pid == pid) {
 				proc = elem;
 				break;
 			}
+
+		_swapk_unlock_queue(sch);
 	}
 
 	return proc;
@@ -560,18 +2036,21 @@ swapk_proc_t *_swapk_find_pid(swapk_scheduler_t *sch,
 void *_swapk_core_launch(void* arg)
 {
 	swapk_scheduler_t *sch = (swapk_scheduler_t*) arg;
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
 	swapk_proc_t *proc = &sch->_sleep_proc[cid];
 
 	/* Extra hardware threads will start with a sleep task and
 	 * will wake up when the scheduler tells them to */
 	sch->current[cid] = proc;
 	proc->core_id = cid;
+	proc->core_last = cid;
 	swapk_startup(proc->stack->stackptr, proc->entry, sch);
 
 	return arg;
 }
 
+#if SWAPK_COOPERATIVE_ONLY == 0
+SWAPK_HOT
 void _swapk_svc_handler(swapk_scheduler_t *sch)
 {
 	if (sch->_call && !sch->_call_complete) {
@@ -583,10 +2062,12 @@ void _swapk_svc_handler(swapk_scheduler_t *sch)
 	swapk_svc_disable();
 }
 
+SWAPK_HOT
 void isr_irq11()
 {
-	_swapk_svc_handler(scheduler_ptr[_swapk_cbptr->core_get_id()]);
+	_swapk_svc_handler(scheduler_ptr[_swapk_core_id(_swapk_cbptr)]);
 }
+#endif /* #if SWAPK_COOPERATIVE_ONLY == 0 */
 
 void isr_irq8()
 {
@@ -596,21 +2077,29 @@ void isr_irq9()
 {
 }
 
+#if SWAPK_COOPERATIVE_ONLY == 0 && SWAPK_HARDWARE_THREADS > 1
+SWAPK_HOT
 void _swapk_call_common(swapk_scheduler_t *sch, swapk_system_call call)
 {
-	scheduler_ptr[sch->cb_list->core_get_id()] = sch;
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+
+	++sch->stats[cid].svc_calls;
+	scheduler_ptr[cid] = sch;
 	sch->_call_calling_pid = swapk_proc_get_pid(sch);
 	sch->_call_complete = false;
 	sch->_call_result = 0;
 	sch->_call = call;
 	swapk_svc_pend();
 }
+#endif
 
+#if SWAPK_HARDWARE_THREADS > 1
+SWAPK_HOT
 int _swapk_call_scheduler_available(int argc, void **argv)
 {
 	(void) argc;
 	swapk_scheduler_t *sch = (swapk_scheduler_t*) argv[1];
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
 
 	for (SWAPK_CORE_ID_T i = 0; i < SWAPK_HARDWARE_THREADS; ++i) {
 		if (i != cid) {
@@ -620,53 +2109,75 @@ int _swapk_call_scheduler_available(int argc, void **argv)
 	}
 
 	sch->cb_list->sem_sch_give();
-	sch->cb_list->signal_event(sch);
+	_swapk_kick_others(sch, cid);
 
 	swapk_event_clear(&sch->events[cid],
 			  SWAPK_SYSTEM_EVENT_PREEMPT_DISABLED);
 
 	return 0;
 }
+#endif /* #if SWAPK_HARDWARE_THREADS > 1 */
 
+#if SWAPK_COOPERATIVE_ONLY > 0 && SWAPK_HARDWARE_THREADS > 1
+SWAPK_HOT
 int _swapk_scheduler_available(void *arg)
 {
 	void *argv[] = {_swapk_call_scheduler_available, arg};
 	return _swapk_call_scheduler_available(2, argv);
 }
+#endif
 
+SWAPK_HOT
 bool _swapk_maybe_switch_context(swapk_scheduler_t *sch)
 {
 	swapk_proc_t *current;
 	swapk_proc_t *next;
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
+	SWAPK_CORE_MASK_T kick;
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
 
 	current = sch->current[cid];
+	++sch->stats[cid].sched_passes;
+
+	/* One critical section for the whole push, sort and pop so
+	 * the queue is never seen half sorted */
+	_swapk_lock_queue(sch);
 
 	if (current) {
-		swapk_push_proc(sch, current);
+		_swapk_insert_sorted_forward(sch, &sch->procqueue, current);
 	} else {
 		current = &sch->_system_proc;
 	}
 
-	swapk_scheduler_sort(sch);
+	kick = _swapk_drain_isr_wakes(sch);
+	_swapk_queue_sort(sch);
 
-	next = swapk_pop_proc(sch);
+	next = _swapk_queue_select(sch);
+
+	/* Cleared under the lock, so a placement made after the
+	 * select still gets its own pass */
+	if (next)
+		swapk_event_clear(&sch->events[cid],
+				  SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH);
+
+	_swapk_unlock_queue(sch);
+
+	_swapk_kick_mask(sch, kick);
 
 	/* No longer need to handle switching to scheduler, as this
 	 * func is only called from scheduler */
-	if (next && next->ready && _swapk_check_core_affinity(sch, next)) {
+	if (next) {
+		if (next->core_last >= 0 && next->core_last != cid)
+			++next->migrations;
+
+		next->core_last = cid;
 		sch->context_shift[cid] = false;
-		swapk_event_clear(&sch->events[cid],
-				  SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH);
 		swapk_call_scheduler_available(sch);
 		_swapk_proc_swap(sch, current, next);
 
 		return true;
 	}
 
-	swapk_push_proc(sch, next);
-
-	return false;;
+	return false;
 }
 
 void *_swapk_sleep_entry(void* arg)
@@ -674,25 +2185,36 @@ void *_swapk_sleep_entry(void* arg)
 	swapk_scheduler_t *sch = (swapk_scheduler_t*) arg;
 
 	for (;;) {
-		sch->cb_list->poll_event(sch);
-		SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
+		SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
 
+		/* Check before polling so a kick that landed before
+		 * this core was listening is not lost */
 		if (swapk_event_check(&sch->events[cid],
 				      (SWAPK_SYSTEM_EVENT_SCH_AVAILABLE |
 				       SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH)))
 			swapk_yield(sch);
+		else
+			sch->cb_list->poll_event(sch);
 	}
 }
 
+#if SWAPK_HARDWARE_THREADS > 1
 void _swapk_wait_for_scheduler(swapk_scheduler_t *sch)
 {
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	uint32_t start = sch->cb_list->get_ticks
+		? sch->cb_list->get_ticks() : 0;
 
 	while (!swapk_event_check(&sch->events[cid],
 				 SWAPK_SYSTEM_EVENT_SCH_AVAILABLE)) {
 		sch->cb_list->poll_event(sch);
 	}
+
+	if (sch->cb_list->get_ticks)
+		sch->stats[cid].sched_wait_ticks +=
+			sch->cb_list->get_ticks() - start;
 }
+#endif
 
 bool _swapk_is_swapk_forever(SWAPK_ABSOLUTE_TIME_T time)
 {
@@ -708,6 +2230,7 @@ bool _swapk_is_swapk_nowait(SWAPK_ABSOLUTE_TIME_T time)
 	/* 	time.tv_sec == SWAPK_NOWAIT.tv_sec; */
 }
 
+SWAPK_HOT
 void _swapk_insert_sorted_forward(swapk_scheduler_t *sch,
 				  struct swapk_proc_queue *q,
 				  swapk_proc_t *proc)
@@ -738,21 +2261,120 @@ void _swapk_insert_sorted_forward(swapk_scheduler_t *sch,
 	}
 }
 
+SWAPK_HOT
 bool _swapk_check_core_affinity(swapk_scheduler_t *sch, swapk_proc_t *proc)
 {
-	SWAPK_CORE_ID_T cid = sch->cb_list->core_get_id();
+#if SWAPK_HARDWARE_THREADS > 1
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+
+	return proc->core_mask & SWAPK_CORE_MASK(cid);
+#else
+	(void) sch;
+	(void) proc;
+	return true;
+#endif
+}
+
+/* Caller must hold the queue lock and the scheduler. Readies every
+ * process woken from an interrupt since the last pass, returning
+ * the other cores that need a kick */
+SWAPK_HOT
+SWAPK_CORE_MASK_T _swapk_drain_isr_wakes(swapk_scheduler_t *sch)
+{
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	SWAPK_CORE_MASK_T kick = 0;
+	uint8_t tail;
+	int placed;
+
+	for (SWAPK_CORE_ID_T i = 0; i < SWAPK_HARDWARE_THREADS; ++i) {
+		/* Cleared first, so a wake raised while we drain asks
+		 * for a pass of its own */
+		sch->_isr_wake_pending[i] = false;
+		SWAPK_MEMORY_BARRIER();
+
+		for (tail = sch->_isr_wake_tail[i];
+		     tail != sch->_isr_wake_head[i]; ++tail)
+			if (_swapk_ready_locked(sch,
+						sch->_isr_wake[i][tail % SWAPK_ISR_WAKE_SLOTS],
+						&placed) &&
+			    placed != SWAPK_CORE_NONE && placed != cid)
+				kick |= SWAPK_CORE_MASK(placed);
+
+		SWAPK_MEMORY_BARRIER();
+		sch->_isr_wake_tail[i] = tail;
+	}
+
+	return kick;
+}
+
+/* True if current is ready, may stay on this core and outranks the
+ * best ready process. Equal priority is a deliberate round robin, so
+ * it still switches */
+SWAPK_HOT
+bool _swapk_still_best(swapk_scheduler_t *sch, swapk_proc_t *current)
+{
+	SWAPK_CORE_ID_T cid = _swapk_core_id(sch->cb_list);
+	swapk_proc_t *head;
+	bool best;
 
-	/* Core affinity is only asserted if negative */
-	if (proc->core_affinity < 0)
-		return proc->core_affinity == -1 * (cid + 1);
+	if (!current->ready || current->exited ||
+	    !_swapk_check_core_affinity(sch, current) ||
+	    swapk_event_check(&sch->events[cid],
+			      SWAPK_SYSTEM_EVENT_CONTEXT_SWITCH))
+		return false;
+
+	_swapk_lock_queue(sch);
+
+	/* Readying requeues in sorted order, so the head is the best
+	 * ready process. If it is pinned to another core we still
+	 * take the pass rather than look further */
+	head = TAILQ_FIRST(&sch->procqueue);
+	best = !head || !head->ready || head->priority > current->priority;
+
+	_swapk_unlock_queue(sch);
 
+	return best;
+}
+
+SWAPK_HOT
+bool _swapk_prefers_core(swapk_proc_t *proc, SWAPK_CORE_ID_T cid)
+{
+#if SWAPK_HARDWARE_THREADS > 1
+	if (proc->core_preferred >= 0)
+		return proc->core_preferred == cid;
+
+	/* No preference, so stay where the caches are warm */
+	return proc->core_last == cid;
+#else
+	(void) proc;
+	(void) cid;
 	return true;
+#endif
+}
+
+/* Caller must hold the queue lock. Takes the first ready process
+ * allowed on this core, so a pinned process at the head can't
+ * starve the rest of the queue */
+SWAPK_HOT
+swapk_proc_t *_swapk_queue_select(swapk_scheduler_t *sch)
+{
+	swapk_proc_t *elem;
+
+	TAILQ_FOREACH(elem, &sch->procqueue, _tailq_entry)
+		if (elem->ready && _swapk_check_core_affinity(sch, elem)) {
+			TAILQ_REMOVE(&sch->procqueue, elem, _tailq_entry);
+			return elem;
+		}
+
+	return NULL;
 }
 
+#if SWAPK_COOPERATIVE_ONLY == 0
 /** @todo This will only work on rp2040: fix that */
+SWAPK_HOT
 void isr_irq14()
 {
-	SWAPK_CORE_ID_T cid = _swapk_cbptr->core_get_id();
+	SWAPK_CORE_ID_T cid = _swapk_core_id(_swapk_cbptr);
 	swapk_scheduler_t *sch = scheduler_ptr[cid];
 
 	sch->_last[cid] = sch->_current[cid] == &sch->_system_proc
@@ -766,6 +2388,12 @@ void isr_irq14()
 	sch->_current[cid]->core_id = -1; /* Meaning not on core */
 	sch->_next[cid]->core_id = cid;
 
+#if SWAPK_PROC_HISTOGRAMS > 0
+	_swapk_hist_switch(_swapk_cbptr, sch->_current[cid],
+			   sch->_next[cid]);
+#endif
+
 	swapk_pendsv_swap(&sch->_current[cid]->stack->stackptr,
 			  &sch->_next[cid]->stack->stackptr);
 }
+#endif /* #if SWAPK_COOPERATIVE_ONLY == 0 */
@@ -0,0 +1,193 @@
+/**
+ * @file swapk_jobs.c
+ * @author Tyler J. Anderson
+ * @brief Swapkernel job queue implementation
+ */
+
+#include "swapk_jobs.h"
+
+#define SWAPK_JOBS_QUEUE_MASK (SWAPK_JOBS_QUEUE_LENGTH - 1)
+
+#if (SWAPK_JOBS_QUEUE_LENGTH & SWAPK_JOBS_QUEUE_MASK) != 0
+#error "SWAPK_JOBS_QUEUE_LENGTH must be a power of two"
+#endif
+
+/*
+**********************************************************************
+*                                                                    *
+*                      Internal API Functions                        *
+*                                                                    *
+**********************************************************************
+*/
+
+static void *_swapk_jobs_worker_entry(void *arg);
+
+static bool _swapk_jobs_push(swapk_jobs_worker_t *w, swapk_job_fn fn,
+			     void *arg, int begin, int end);
+
+/*
+**********************************************************************
+*                                                                    *
+*                       Public API Functions                         *
+*                                                                    *
+**********************************************************************
+*/
+
+void swapk_jobs_init(swapk_jobs_t *jobs, swapk_scheduler_t *sch)
+{
+	jobs->sch = sch;
+	jobs->worker_cnt = 0;
+	jobs->submitted = 0;
+	jobs->_next = 0;
+	swapk_waitlist_init(&jobs->_done);
+}
+
+int swapk_jobs_add_worker(swapk_jobs_t *jobs, swapk_stack_t *stack,
+			  int priority, SWAPK_CORE_ID_T cid)
+{
+	swapk_jobs_worker_t *w;
+
+	if (jobs->worker_cnt >= SWAPK_JOBS_MAX_WORKERS || priority < 0)
+		return -1;
+
+	w = &jobs->workers[jobs->worker_cnt];
+	w->_head = 0;
+	w->_tail = 0;
+	w->_completed = 0;
+	w->_jobs = jobs;
+	swapk_waitlist_init(&w->_idle);
+
+	swapk_proc_init_arg(jobs->sch, &w->proc, stack,
+			    _swapk_jobs_worker_entry, w, priority);
+	swapk_proc_set_affinity(&w->proc, SWAPK_CORE_MASK(cid), cid);
+
+	return jobs->worker_cnt++;
+}
+
+void swapk_jobs_submit(swapk_jobs_t *jobs, swapk_job_fn fn, void *arg,
+		       int begin, int end)
+{
+	for (int i = 0; i < jobs->worker_cnt; ++i) {
+		swapk_jobs_worker_t *w = &jobs->workers[jobs->_next];
+
+		if (++jobs->_next >= jobs->worker_cnt)
+			jobs->_next = 0;
+
+		if (_swapk_jobs_push(w, fn, arg, begin, end)) {
+			++jobs->submitted;
+			swapk_waitlist_notify_all(jobs->sch, &w->_idle);
+			return;
+		}
+	}
+
+	/* Everyone is backed up, so do it ourselves rather than wait */
+	fn(arg, begin, end);
+}
+
+uint32_t swapk_jobs_pending(swapk_jobs_t *jobs)
+{
+	uint32_t completed = 0;
+
+	for (int i = 0; i < jobs->worker_cnt; ++i)
+		completed += jobs->workers[i]._completed;
+
+	return jobs->submitted - completed;
+}
+
+void swapk_jobs_wait(swapk_jobs_t *jobs)
+{
+	for (;;) {
+		uint32_t seq = swapk_waitlist_prepare(&jobs->_done);
+
+		SWAPK_MEMORY_BARRIER();
+
+		if (!swapk_jobs_pending(jobs))
+			return;
+
+		swapk_waitlist_wait(jobs->sch, &jobs->_done, seq,
+				    SWAPK_FOREVER);
+	}
+}
+
+void swapk_parallel_for(swapk_jobs_t *jobs, int begin, int end, int grain,
+			swapk_job_fn fn, void *arg)
+{
+	if (grain < 1)
+		grain = 1;
+
+	/* Nobody to share with */
+	if (!jobs->worker_cnt) {
+		fn(arg, begin, end);
+		return;
+	}
+
+	for (int i = begin; i < end; i += grain)
+		swapk_jobs_submit(jobs, fn, arg, i,
+				  end - i > grain ? i + grain : end);
+
+	swapk_jobs_wait(jobs);
+}
+
+/*
+**********************************************************************
+*                                                                    *
+*                    Internal API Implementation                     *
+*                                                                    *
+**********************************************************************
+*/
+
+bool _swapk_jobs_push(swapk_jobs_worker_t *w, swapk_job_fn fn, void *arg,
+		      int begin, int end)
+{
+	uint32_t head = w->_head;
+	swapk_job_t *job;
+
+	if (head - w->_tail >= SWAPK_JOBS_QUEUE_LENGTH)
+		return false;
+
+	job = &w->_queue[head & SWAPK_JOBS_QUEUE_MASK];
+	job->fn = fn;
+	job->arg = arg;
+	job->begin = begin;
+	job->end = end;
+
+	/* Job must be visible before the worker can see the slot */
+	SWAPK_MEMORY_BARRIER();
+	w->_head = head + 1;
+
+	return true;
+}
+
+void *_swapk_jobs_worker_entry(void *arg)
+{
+	swapk_jobs_worker_t *w = arg;
+	swapk_scheduler_t *sch = w->_jobs->sch;
+
+	for (;;) {
+		uint32_t tail = w->_tail;
+		uint32_t seq = swapk_waitlist_prepare(&w->_idle);
+		swapk_job_t *job;
+
+		SWAPK_MEMORY_BARRIER();
+
+		if (tail == w->_head) {
+			swapk_waitlist_wait(sch, &w->_idle, seq,
+					    SWAPK_FOREVER);
+			continue;
+		}
+
+		job = &w->_queue[tail & SWAPK_JOBS_QUEUE_MASK];
+		job->fn(job->arg, job->begin, job->end);
+
+		/* Done with the slot before handing it back */
+		SWAPK_MEMORY_BARRIER();
+		w->_tail = tail + 1;
+		++w->_completed;
+
+		/* The submitter only cares once we have run dry */
+		if (w->_tail == w->_head)
+			swapk_waitlist_notify_all(sch, &w->_jobs->_done);
+	}
+
+	return NULL;
+}
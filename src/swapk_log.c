@@ -0,0 +1,172 @@
+/**
+ * @file swapk_log.c
+ * @author Tyler J. Anderson
+ * @brief Swapkernel deferred-format log implementation
+ */
+
+#include "swapk_log.h"
+
+#include <stdio.h>
+
+#define SWAPK_LOG_RING_MASK (SWAPK_LOG_RING_WORDS - 1)
+
+#if (SWAPK_LOG_RING_WORDS & SWAPK_LOG_RING_MASK) != 0
+#error "SWAPK_LOG_RING_WORDS must be a power of two"
+#endif
+
+/* Writers on a core mask interrupts, so each ring has one producer
+ * and one reader */
+typedef struct {
+	uint32_t data[SWAPK_LOG_RING_WORDS];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	uint32_t dropped;
+} swapk_log_ring_t;
+
+static swapk_scheduler_t *_swapk_log_sch;
+static swapk_log_ring_t _swapk_log_rings[SWAPK_HARDWARE_THREADS];
+
+/*
+**********************************************************************
+*                                                                    *
+*                      Internal API Functions                        *
+*                                                                    *
+**********************************************************************
+*/
+
+static SWAPK_CORE_ID_T _swapk_log_core_id();
+
+/*
+**********************************************************************
+*                                                                    *
+*                       Public API Functions                         *
+*                                                                    *
+**********************************************************************
+*/
+
+void swapk_log_init(swapk_scheduler_t *sch)
+{
+	_swapk_log_sch = sch;
+
+	for (int i = 0; i < SWAPK_HARDWARE_THREADS; ++i) {
+		_swapk_log_rings[i].head = 0;
+		_swapk_log_rings[i].tail = 0;
+		_swapk_log_rings[i].dropped = 0;
+	}
+}
+
+SWAPK_HOT
+void swapk_log_record(uint32_t hdr, const char *fmt, const uint32_t *args)
+{
+	swapk_scheduler_t *sch = _swapk_log_sch;
+	uint32_t words = SWAPK_LOG_RECORD_WORDS(hdr);
+	uint32_t ticks = 0;
+	swapk_log_ring_t *ring;
+	SWAPK_CORE_ID_T cid;
+	uint32_t head;
+	uint32_t save;
+
+	if (!sch)
+		return;
+
+	if (sch->cb_list->get_ticks)
+		ticks = sch->cb_list->get_ticks();
+
+	save = swapk_irq_save();
+	cid = _swapk_log_core_id();
+	ring = &_swapk_log_rings[cid];
+	head = ring->head;
+
+	if (SWAPK_LOG_RING_WORDS - (head - ring->tail) < words) {
+		++ring->dropped;
+		swapk_irq_restore(save);
+		return;
+	}
+
+	hdr |= ((uint32_t) cid & 0xf) << 8;
+	hdr |= (uint32_t) swapk_proc_get_pid(sch) << 16;
+
+	ring->data[head++ & SWAPK_LOG_RING_MASK] = hdr;
+	ring->data[head++ & SWAPK_LOG_RING_MASK] = ticks;
+	ring->data[head++ & SWAPK_LOG_RING_MASK] = (uint32_t) (uintptr_t) fmt;
+
+	for (uint32_t i = 0; i < (hdr & 0xf); ++i)
+		ring->data[head++ & SWAPK_LOG_RING_MASK] = args[i];
+
+	SWAPK_MEMORY_BARRIER();
+	ring->head = head;
+	swapk_irq_restore(save);
+}
+
+size_t swapk_log_read(SWAPK_CORE_ID_T cid, uint32_t *out, size_t max)
+{
+	swapk_log_ring_t *ring = &_swapk_log_rings[cid];
+	uint32_t tail = ring->tail;
+	uint32_t head = ring->head;
+	size_t copied = 0;
+
+	SWAPK_MEMORY_BARRIER();
+
+	while (tail != head) {
+		uint32_t words = SWAPK_LOG_RECORD_WORDS(
+			ring->data[tail & SWAPK_LOG_RING_MASK]);
+
+		if (copied + words > max)
+			break;
+
+		for (uint32_t i = 0; i < words; ++i)
+			out[copied++] = ring->data[tail++ & SWAPK_LOG_RING_MASK];
+	}
+
+	SWAPK_MEMORY_BARRIER();
+	ring->tail = tail;
+
+	return copied;
+}
+
+int swapk_log_format(const uint32_t *rec, char *buf, size_t len)
+{
+	static const char *const levels[] = {"-", "E", "W", "I", "D"};
+	uint32_t level = (rec[0] >> 4) & 0xf;
+	uint32_t a[SWAPK_LOG_MAX_ARGS] = {0};
+	int n;
+
+	for (uint32_t i = 0; i < (rec[0] & 0xf); ++i)
+		a[i] = rec[3 + i];
+
+	n = snprintf(buf, len, "[%10lu] %s c%lu pid %lu: ",
+		     (unsigned long) rec[1],
+		     level <= SWAPK_LOG_LEVEL_DEBUG ? levels[level] : "?",
+		     (unsigned long) ((rec[0] >> 8) & 0xf),
+		     (unsigned long) (rec[0] >> 16));
+
+	if (n < 0 || (size_t) n >= len)
+		return n;
+
+	/* Unused words are passed too, and ignored by the format */
+	return n + snprintf(buf + n, len - n, (const char*) (uintptr_t) rec[2],
+			    a[0], a[1], a[2], a[3]);
+}
+
+uint32_t swapk_log_dropped(SWAPK_CORE_ID_T cid)
+{
+	return _swapk_log_rings[cid].dropped;
+}
+
+/*
+**********************************************************************
+*                                                                    *
+*                    Internal API Implementation                     *
+*                                                                    *
+**********************************************************************
+*/
+
+SWAPK_HOT
+SWAPK_CORE_ID_T _swapk_log_core_id()
+{
+#if SWAPK_HARDWARE_THREADS > 1
+	return _swapk_log_sch->cb_list->core_get_id();
+#else
+	return 0;
+#endif
+}
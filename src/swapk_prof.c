@@ -0,0 +1,142 @@
+/**
+ * @file swapk_prof.c
+ * @author Tyler J. Anderson
+ * @brief Swapkernel sampling profiler implementation
+ */
+
+#include "swapk_prof.h"
+
+#define SWAPK_PROF_RING_MASK (SWAPK_PROF_RING_WORDS - 1)
+
+#if (SWAPK_PROF_RING_WORDS & SWAPK_PROF_RING_MASK) != 0 || \
+	SWAPK_PROF_RING_WORDS < SWAPK_PROF_SAMPLE_WORDS
+#error "SWAPK_PROF_RING_WORDS must be a power of two of at least 2"
+#endif
+
+/* Only the timer exception on a core writes its ring, so each ring
+ * has one producer and one reader */
+typedef struct {
+	uint32_t data[SWAPK_PROF_RING_WORDS];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	uint32_t dropped;
+} swapk_prof_ring_t;
+
+static swapk_scheduler_t *_swapk_prof_sch;
+static swapk_prof_ring_t _swapk_prof_rings[SWAPK_HARDWARE_THREADS];
+
+/*
+**********************************************************************
+*                                                                    *
+*                      Internal API Functions                        *
+*                                                                    *
+**********************************************************************
+*/
+
+static SWAPK_CORE_ID_T _swapk_prof_core_id();
+
+/*
+**********************************************************************
+*                                                                    *
+*                       Public API Functions                         *
+*                                                                    *
+**********************************************************************
+*/
+
+void swapk_prof_init(swapk_scheduler_t *sch)
+{
+	for (int i = 0; i < SWAPK_HARDWARE_THREADS; ++i) {
+		_swapk_prof_rings[i].head = 0;
+		_swapk_prof_rings[i].tail = 0;
+		_swapk_prof_rings[i].dropped = 0;
+	}
+
+	SWAPK_MEMORY_BARRIER();
+	_swapk_prof_sch = sch;
+}
+
+SWAPK_HOT
+void swapk_prof_record(uint32_t pc, bool handler)
+{
+	swapk_scheduler_t *sch = _swapk_prof_sch;
+	swapk_prof_ring_t *ring;
+	swapk_proc_t *current;
+	SWAPK_CORE_ID_T cid;
+	uint32_t head;
+	uint32_t hdr;
+
+	if (!sch)
+		return;
+
+	cid = _swapk_prof_core_id();
+	ring = &_swapk_prof_rings[cid];
+	head = ring->head;
+
+	if (SWAPK_PROF_RING_WORDS - (head - ring->tail) <
+	    SWAPK_PROF_SAMPLE_WORDS) {
+		++ring->dropped;
+		return;
+	}
+
+	/* A process stack always belongs to this core's current
+	 * process, or the system process if there is none */
+	current = sch->current[cid] ? sch->current[cid] : &sch->_system_proc;
+
+	hdr = ((uint32_t) SWAPK_PROF_HDR_SYNC << 12) |
+		(((uint32_t) cid & 0xf) << 8);
+
+	if (handler)
+		hdr |= SWAPK_PROF_HDR_HANDLER |
+			((uint32_t) SWAPK_INVALID_PID << 16);
+	else
+		hdr |= (uint32_t) current->pid << 16;
+
+	ring->data[head++ & SWAPK_PROF_RING_MASK] = hdr;
+	ring->data[head++ & SWAPK_PROF_RING_MASK] = pc;
+
+	SWAPK_MEMORY_BARRIER();
+	ring->head = head;
+}
+
+size_t swapk_prof_read(SWAPK_CORE_ID_T cid, uint32_t *out, size_t max)
+{
+	swapk_prof_ring_t *ring = &_swapk_prof_rings[cid];
+	uint32_t tail = ring->tail;
+	uint32_t head = ring->head;
+	size_t copied = 0;
+
+	SWAPK_MEMORY_BARRIER();
+
+	while (tail != head && copied + SWAPK_PROF_SAMPLE_WORDS <= max)
+		for (int i = 0; i < SWAPK_PROF_SAMPLE_WORDS; ++i)
+			out[copied++] = ring->data[tail++ &
+						   SWAPK_PROF_RING_MASK];
+
+	SWAPK_MEMORY_BARRIER();
+	ring->tail = tail;
+
+	return copied;
+}
+
+uint32_t swapk_prof_dropped(SWAPK_CORE_ID_T cid)
+{
+	return _swapk_prof_rings[cid].dropped;
+}
+
+/*
+**********************************************************************
+*                                                                    *
+*                    Internal API Implementation                     *
+*                                                                    *
+**********************************************************************
+*/
+
+SWAPK_HOT
+SWAPK_CORE_ID_T _swapk_prof_core_id()
+{
+#if SWAPK_HARDWARE_THREADS > 1
+	return _swapk_prof_sch->cb_list->core_get_id();
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Decode swapkernel SWAPK_LOG() records against the firmware ELF.
+
+The dump is the raw little endian words returned by swapk_log_read(),
+or with --hex, the same words written as whitespace separated hex.
+Format strings and %s arguments are read from the ELF, so it must be
+the image that produced the dump.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+LEVELS = {0: "-", 1: "E", 2: "W", 3: "I", 4: "D"}
+HDR_SYNC = 0xA
+SPEC = re.compile(r"%([-+ #0]*)(\d+|\*)?(?:\.(\d+))?(hh|h|ll|l|z|j|t)?"
+                  r"([diouxXcspn%])")
+
+
+class Elf:
+    """Just enough of ELF32 to read bytes at a load address."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1:
+            sys.exit(f"{path}: not a 32 bit ELF")
+
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", self.data, 0x2E)
+        self.sections = []
+
+        for i in range(shnum):
+            (_, sh_type, flags, addr, offset,
+             size) = struct.unpack_from("<IIIIII", self.data,
+                                        shoff + i * shentsize)
+
+            # Allocated and backed by file contents
+            if flags & 0x2 and sh_type != 8 and size:
+                self.sections.append((addr, offset, size))
+
+    def cstring(self, addr):
+        for base, offset, size in self.sections:
+            if base <= addr < base + size:
+                start = offset + addr - base
+                end = self.data.find(b"\0", start, offset + size)
+                end = offset + size if end < 0 else end
+                return self.data[start:end].decode("utf-8", "replace")
+
+        return None
+
+
+def format_record(elf, fmt_addr, args):
+    fmt = elf.cstring(fmt_addr)
+
+    if fmt is None:
+        return f"<format 0x{fmt_addr:08x} not in ELF> " + \
+            " ".join(f"0x{a:08x}" for a in args)
+
+    args = list(args)
+    out = []
+    pos = 0
+
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, _, conv = m.groups()
+
+        if conv == "%":
+            out.append("%")
+            continue
+
+        val = args.pop(0) if args else 0
+        spec = "%" + flags + (width or "") + \
+            ("." + prec if prec is not None else "")
+
+        if conv in "di":
+            out.append((spec + "d") % (val - (1 << 32)
+                                       if val & 0x80000000 else val))
+        elif conv == "s":
+            s = elf.cstring(val)
+            out.append((spec + "s") % (s if s is not None
+                                       else f"<0x{val:08x}>"))
+        elif conv == "c":
+            out.append((spec + "c") % chr(val & 0xFF))
+        elif conv == "p":
+            out.append(f"0x{val:08x}")
+        elif conv == "n":
+            pass
+        else:
+            out.append((spec + conv) % val)
+
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def records(words):
+    i = 0
+
+    while i + 3 <= len(words):
+        hdr = words[i]
+
+        # Lost sync, e.g. a dump cut mid record, so skip a word
+        if (hdr >> 12) & 0xF != HDR_SYNC or (hdr & 0xF) > 4:
+            i += 1
+            continue
+
+        n = 3 + (hdr & 0xF)
+
+        if i + n > len(words):
+            break
+
+        yield hdr, words[i + 1], words[i + 2], words[i + 3:i + n]
+        i += n
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("elf", help="firmware ELF the log came from")
+    ap.add_argument("dump", help="log words, '-' for stdin")
+    ap.add_argument("--hex", action="store_true",
+                    help="dump is hex words rather than binary")
+    opts = ap.parse_args()
+
+    elf = Elf(opts.elf)
+    src = sys.stdin.buffer if opts.dump == "-" else open(opts.dump, "rb")
+    raw = src.read()
+
+    if opts.hex:
+        words = [int(w, 16) for w in raw.split()]
+    else:
+        raw = raw[:len(raw) & ~3]
+        words = list(struct.unpack(f"<{len(raw) // 4}I", raw))
+
+    for hdr, ticks, fmt, args in records(words):
+        level = LEVELS.get((hdr >> 4) & 0xF, "?")
+        core = (hdr >> 8) & 0xF
+        pid = hdr >> 16
+        print(f"[{ticks:10d}] {level} c{core} pid {pid}: "
+              f"{format_record(elf, fmt, args)}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""Turn swapkernel profiler samples into per process flat profiles.
+
+The dump is the raw little endian words returned by swapk_prof_read(),
+or with --hex, the same words written as whitespace separated hex, as
+printed by swapk_pico_prof_dump(). Anything else in a hex dump, such
+as other console output, is skipped. PCs are looked up in the symbol
+table of the ELF, so it must be the image that took the samples.
+"""
+
+import argparse
+import bisect
+import collections
+import struct
+import sys
+
+HDR_SYNC = 0xB
+HDR_HANDLER = 0x1
+SHT_SYMTAB = 2
+STT_FUNC = 2
+
+
+class Elf:
+    """Just enough of ELF32 to find the function holding an address."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+
+        if data[:4] != b"\x7fELF" or data[4] != 1:
+            sys.exit(f"{path}: not a 32 bit ELF")
+
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+        sections = [struct.unpack_from("<IIIIIIIIII", data,
+                                       shoff + i * shentsize)
+                    for i in range(shnum)]
+        funcs = {}
+
+        for (_, sh_type, _, _, offset, size, link, _, _,
+             entsize) in sections:
+            if sh_type != SHT_SYMTAB or not entsize:
+                continue
+
+            stroff = sections[link][4]
+
+            for i in range(size // entsize):
+                (name, value, sym_size, info, _,
+                 shndx) = struct.unpack_from("<IIIBBH", data,
+                                             offset + i * entsize)
+
+                if info & 0xF != STT_FUNC or not shndx:
+                    continue
+
+                end = data.index(b"\0", stroff + name)
+                # Thumb functions have bit 0 set
+                funcs[value & ~1] = (sym_size, data[stroff + name:end]
+                                     .decode("utf-8", "replace"))
+
+        if not funcs:
+            sys.exit(f"{path}: no function symbols, is it stripped?")
+
+        self.addrs = sorted(funcs)
+        self.funcs = [funcs[a] for a in self.addrs]
+
+    def function(self, pc):
+        i = bisect.bisect_right(self.addrs, pc) - 1
+
+        if i < 0:
+            return None
+
+        size, name = self.funcs[i]
+
+        # Unsized symbols, often from assembly, run to the next one
+        if size and pc >= self.addrs[i] + size:
+            return None
+
+        return name
+
+
+def samples(words):
+    i = 0
+
+    while i + 2 <= len(words):
+        hdr = words[i]
+
+        # Lost sync, e.g. a dump cut mid sample, so skip a word
+        if (hdr >> 12) & 0xF != HDR_SYNC:
+            i += 1
+            continue
+
+        yield hdr, words[i + 1]
+        i += 2
+
+
+def hex_words(raw):
+    for tok in raw.split():
+        if len(tok) != 8:
+            continue
+
+        try:
+            yield int(tok, 16)
+        except ValueError:
+            pass
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("elf", help="firmware ELF the samples came from")
+    ap.add_argument("dump", help="sample words, '-' for stdin")
+    ap.add_argument("--hex", action="store_true",
+                    help="dump is hex words rather than binary")
+    ap.add_argument("--top", type=int, default=20,
+                    help="functions to list per process (default 20)")
+    ap.add_argument("--core", type=int,
+                    help="only count samples from this core")
+    opts = ap.parse_args()
+
+    elf = Elf(opts.elf)
+    src = sys.stdin.buffer if opts.dump == "-" else open(opts.dump, "rb")
+    raw = src.read()
+
+    if opts.hex:
+        words = list(hex_words(raw))
+    else:
+        raw = raw[:len(raw) & ~3]
+        words = list(struct.unpack(f"<{len(raw) // 4}I", raw))
+
+    profiles = collections.defaultdict(collections.Counter)
+    total = 0
+
+    for hdr, pc in samples(words):
+        if opts.core is not None and (hdr >> 8) & 0xF != opts.core:
+            continue
+
+        owner = "handlers" if hdr & HDR_HANDLER else f"pid {hdr >> 16}"
+        name = elf.function(pc & ~1) or f"0x{pc:08x}"
+        profiles[owner][name] += 1
+        total += 1
+
+    if not total:
+        sys.exit("no samples found")
+
+    for owner, counts in sorted(profiles.items(),
+                                key=lambda kv: -sum(kv[1].values())):
+        n = sum(counts.values())
+        print(f"{owner}: {n} samples, {100.0 * n / total:.1f}% of all")
+
+        for name, count in counts.most_common(opts.top):
+            print(f"  {100.0 * count / n:6.2f}% {count:8d}  {name}")
+
+        print()
+
+
+if __name__ == "__main__":
+    main()